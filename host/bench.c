@@ -0,0 +1,266 @@
+#include <pebble.h>
+#include <time.h>
+#include "host.h"
+#include "phone.h"
+#include "devicecache.h"
+#include "devicecard_layer.h"
+
+// Microbenchmarks of the watch code running on the host against the simulated SDK and phone.
+// Each benchmark reports the CPU time and heap allocations per operation (and drawing operations
+// for update procs). Host timings are only comparable with each other, not with the watch, but
+// relative costs and allocation counts carry over.
+//
+// Usage: bench [iterations]
+
+#define DEFAULT_ITERATIONS 20000
+#define DEVICE_COUNT 20
+
+// App entry point (main.c is compiled with main renamed) and main.c callbacks being measured
+int homep_main(void);
+void device_status_fetched(int device_id, DeviceStatus status, time_t status_changed);
+void device_status_change(void);
+
+static int s_iterations = DEFAULT_ITERATIONS;
+static bool s_setup_ok = false;
+
+// Measurement of one benchmark (only the code between bench_resume and bench_pause is counted)
+typedef struct {
+  const char *name;
+  uint64_t ns;
+  struct timespec started;
+  HostHeapStats heap_started;
+  uint32_t allocs;
+  uint32_t bytes;
+  HostDrawStats draw;
+} Bench;
+
+static void bench_resume(Bench *bench) {
+  bench->heap_started = host_heap_stats();
+  clock_gettime(CLOCK_MONOTONIC, &bench->started);
+}
+
+static void bench_pause(Bench *bench) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  HostHeapStats heap = host_heap_stats();
+  bench->ns += (now.tv_sec - bench->started.tv_sec) * 1000000000ull + now.tv_nsec - bench->started.tv_nsec;
+  bench->allocs += heap.allocs - bench->heap_started.allocs;
+  bench->bytes += heap.bytes_allocated - bench->heap_started.bytes_allocated;
+}
+
+static void bench_report(Bench *bench, int ops) {
+  printf("%-32s %8d %10.1f %10.2f %10.1f", bench->name, ops, (double)bench->ns / ops,
+         (double)bench->allocs / ops, (double)bench->bytes / ops);
+  if (bench->draw.ops > 0)
+    printf(" %8.1f %8.1f", (double)bench->draw.ops / ops, (double)bench->draw.text_ops / ops);
+  printf("\n");
+}
+
+// Inbound dictionary parsing in the inbox handler (the delayed callbacks it sets up run untimed)
+static void bench_inbox_status(void) {
+  Bench bench = {.name = "inbox: device status"};
+  uint8_t buffer[256];
+  uint16_t sizes[2];
+  uint8_t messages[2][256];
+  time_t now;
+  time_ms(&now, NULL);
+  sizes[0] = phone_build_status(messages[0], sizeof(messages[0]), phone_device_id(0), DSClosed, now - 3600);
+  sizes[1] = phone_build_status(messages[1], sizeof(messages[1]), phone_device_id(0), DSOnOpen, now - 60);
+
+  for (int i = 0; i < s_iterations; i++) {
+    memcpy(buffer, messages[i % 2], sizes[i % 2]);
+    bench_resume(&bench);
+    host_inbox_deliver(buffer, sizes[i % 2]);
+    bench_pause(&bench);
+    host_run_timers(100);
+  }
+  bench_report(&bench, s_iterations);
+}
+
+static void bench_inbox_summary(void) {
+  Bench bench = {.name = "inbox: summary (20 devices)"};
+  uint8_t message[1024];
+  uint16_t size = phone_build_summary(message, sizeof(message), 0, DEVICE_COUNT);
+
+  for (int i = 0; i < s_iterations; i++) {
+    bench_resume(&bench);
+    host_inbox_deliver(message, size);
+    bench_pause(&bench);
+    host_run_timers(100);
+  }
+  bench_report(&bench, s_iterations);
+}
+
+// Applying changes to the device list pushed by the phone (the last device is removed then added back),
+// including the delayed callback that rebuilds the list and cache
+static void bench_list_changes(void) {
+  Bench bench = {.name = "list: remove/add device"};
+  uint8_t messages[2][64];
+  uint16_t sizes[2];
+  int32_t last_id = phone_device_id(DEVICE_COUNT - 1);
+  sizes[0] = phone_build_changes(messages[0], sizeof(messages[0]), NULL, 0, &last_id, 1);
+  sizes[1] = phone_build_changes(messages[1], sizeof(messages[1]), &last_id, 1, NULL, 0);
+  int selected_id = g_device_id_list[g_device_selected];
+
+  for (int i = 0; i < s_iterations; i++) {
+    bench_resume(&bench);
+    host_inbox_deliver(messages[i % 2], sizes[i % 2]);
+    host_run_timers(100);
+    bench_pause(&bench);
+  }
+  bench_report(&bench, s_iterations);
+  if (g_device_count != DEVICE_COUNT || g_device_id_list[g_device_selected] != selected_id ||
+      !devicecache_get(g_device_selected)->has_details)
+    fprintf(stderr, "bench: device list changes lost the selected device\n");
+}
+
+// The status state machine when a fetched status is just shown
+static void bench_status_idle(void) {
+  Bench bench = {.name = "status fetched: idle"};
+  int device_id = phone_device_id(0);
+  time_t now;
+  time_ms(&now, NULL);
+
+  bench_resume(&bench);
+  for (int i = 0; i < s_iterations; i++)
+    device_status_fetched(device_id, (i % 2) ? DSOnOpen : DSClosed, (i % 2) ? now - 60 : now - 3600);
+  bench_pause(&bench);
+  host_run_timers(1000);
+  bench_report(&bench, s_iterations);
+}
+
+// A full status change: requesting the change, a fetch before the target is reached and then the
+// fetch that reaches it
+static void bench_status_change(void) {
+  Bench bench = {.name = "status fetched: change cycle"};
+  int device_id = phone_device_id(0);
+  DeviceStatus status = devicecache_get(0)->status;
+
+  for (int i = 0; i < s_iterations; i++) {
+    DeviceStatus target = (status == DSClosed) ? DSOnOpen : DSClosed;
+    bench_resume(&bench);
+    device_status_change();
+    device_status_fetched(device_id, (target == DSOnOpen) ? DSOpening : DSClosing, 0);
+    device_status_fetched(device_id, target, time(NULL));
+    bench_pause(&bench);
+    status = target;
+    // Let the status change request and its confirmation go through
+    host_run_timers(200);
+  }
+  bench_report(&bench, s_iterations);
+}
+
+// Describing how long a device has had its status, which the cards redo every minute
+static void bench_card_age(void) {
+  Bench bench = {.name = "card: age refresh (tick)"};
+  DeviceCardLayer *card = devicecard_layer_create(GRect(0, 0, 114, 128));
+  time_t now = time(NULL);
+  time_t changed[] = {now - 300, now - 5 * 3600, now - 3 * 86400};
+
+  bench_resume(&bench);
+  for (int i = 0; i < s_iterations; i++) {
+    card->status_changed = changed[i % 3];
+    devicecard_layer_refresh_age(card);
+  }
+  bench_pause(&bench);
+
+  devicecard_layer_destroy(card);
+  host_run_timers(0);
+  bench_report(&bench, s_iterations);
+}
+
+// Card update procs for each kind of card
+static void bench_card(const char *name, DeviceType device_type, DeviceStatus status) {
+  Bench bench = {.name = name};
+  GContext *ctx = host_gcontext_create();
+  DeviceCardLayer *card = devicecard_layer_create(GRect(0, 0, 114, 128));
+  devicecard_layer_set_type(card, device_type);
+  devicecard_layer_set_location(card, strarena_intern("Garage"));
+  devicecard_layer_set_name(card, strarena_intern("Door 1"));
+  devicecard_layer_set_status(card, status);
+  devicecard_layer_set_status_changed(card, time(NULL) - 3600);
+
+  bench_resume(&bench);
+  for (int i = 0; i < s_iterations; i++)
+    host_render(devicecard_layer_get_layer(card), ctx);
+  bench_pause(&bench);
+  bench.draw = host_gcontext_stats(ctx);
+
+  devicecard_layer_destroy(card);
+  host_run_timers(0);
+  host_gcontext_destroy(ctx);
+  bench_report(&bench, s_iterations);
+}
+
+static void bench_main_window(void) {
+  Bench bench = {.name = "render: main window"};
+  GContext *ctx = host_gcontext_create();
+  bench_resume(&bench);
+  for (int i = 0; i < s_iterations; i++)
+    host_render_top_window(ctx);
+  bench_pause(&bench);
+  bench.draw = host_gcontext_stats(ctx);
+  host_gcontext_destroy(ctx);
+  bench_report(&bench, s_iterations);
+}
+
+// Scrolling through the devices one click at a time, including the fetches once each settles
+static void bench_scroll(void) {
+  Bench bench = {.name = "scroll: click + settle"};
+  int ops = s_iterations / 10;
+  for (int i = 0; i < ops; i++) {
+    bench_resume(&bench);
+    host_click(BUTTON_ID_DOWN, 0);
+    host_run_timers(1000);
+    bench_pause(&bench);
+  }
+  bench_report(&bench, ops);
+}
+
+// Run in place of the app's event loop once the app has initialised
+static void event_loop(void) {
+  // Start up as the JS does, and let the first device load
+  phone_connect();
+  host_run_timers(2000);
+  DeviceCacheEntry *entry = devicecache_get(0);
+  if (entry == NULL || !entry->has_details || entry->status == DSNone) {
+    fprintf(stderr, "bench: app did not load the first device\n");
+    return;
+  }
+  s_setup_ok = true;
+
+  printf("%-32s %8s %10s %10s %10s %8s %8s\n", "benchmark", "ops", "ns/op", "allocs/op", "bytes/op",
+         "draws/op", "text/op");
+  bench_inbox_status();
+  bench_inbox_summary();
+  bench_list_changes();
+  bench_status_idle();
+  bench_status_change();
+  bench_card_age();
+  bench_card("card: garage closed", DTGarageDoor, DSClosed);
+  bench_card("card: garage opening", DTGarageDoor, DSOpening);
+  bench_card("card: light on", DTLightSwitch, DSOnOpen);
+  bench_card("card: gate open", DTGate, DSOnOpen);
+  bench_main_window();
+  bench_scroll();
+
+  HostHeapStats heap = host_heap_stats();
+  printf("\nheap: %d bytes in use, %d peak (of %d)\n", (int)heap.used, (int)heap.peak_used, HOST_HEAP_SIZE);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1) s_iterations = atoi(argv[1]);
+  if (s_iterations <= 0) s_iterations = DEFAULT_ITERATIONS;
+
+  phone_init(DEVICE_COUNT);
+  host_set_event_loop(event_loop);
+  homep_main();
+
+  // Anything left after the app deinitialises is leaked
+  int timers = host_pending_timers();
+  host_shutdown();
+  HostHeapStats heap = host_heap_stats();
+  printf("heap: %d bytes leaked at exit (%u allocs, %u frees), %d timers left pending\n", 
+         (int)heap.used, heap.allocs, heap.frees, timers);
+  return s_setup_ok ? 0 : 1;
+}
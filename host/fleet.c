@@ -0,0 +1,220 @@
+#include <pebble.h>
+#include <time.h>
+#include "host.h"
+#include "phone.h"
+#include "devicecache.h"
+#include "strarena.h"
+
+// Scale test of the watch app with a generated fleet of devices, driven through the real comms path
+// by the simulated phone. A scripted session starts the app, opens the overview, scrolls through
+// every device and opens or closes the first door, and reports the transfer (simulated time, messages and bytes),
+// the latency of each step, the peak heap and the string arena, so capacity limits such as the heap
+// needed per device are measured rather than guessed. (The inbox limits the device list to a number
+// of device IDs, 4 bytes each, whatever the length of the names, which only count towards the heap.)
+//
+// Usage: fleet [doors lights gates [name_length [travel_ms [volatility]]]]
+
+// Longest a step may take (in simulated time) and how often it is checked for completion
+#define STEP_LIMIT_MS 60000
+#define STEP_MS 10
+// comms.c hands each message to the app this long after it arrives
+#define CALLBACK_DELAY_MS 100
+
+// App entry point (main.c is compiled with main renamed)
+int homep_main(void);
+
+static PhoneFleet s_fleet = {.doors = 3, .lights = 2, .gates = 0, .locations = 4, .travel_ms = 12000};
+static int s_device_total = 0;
+static bool s_session_ok = false;
+static uint32_t s_fetches_before = 0;
+static DeviceStatus s_door_target = DSNone;
+
+// A step of the session: the simulated time, CPU time and phone messages it took
+typedef struct {
+  uint32_t ms;
+  uint64_t ns;
+  PhoneStats phone;
+} Step;
+
+static uint64_t now_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+// Run timers until a step is done and the app has handled the last message (returning false if it does
+// not finish in time), measuring it from 'started'
+static bool run_until(bool (*done)(void), Step *step, uint32_t started_ms, uint64_t started_ns,
+                      PhoneStats started_phone) {
+  bool finished;
+  while (!(finished = done()) && host_now() - started_ms < STEP_LIMIT_MS) host_run_timers(STEP_MS);
+  if (finished) host_run_timers(CALLBACK_DELAY_MS);
+  PhoneStats phone = phone_stats();
+  step->ms = host_now() - started_ms;
+  step->ns = now_ns() - started_ns;
+  step->phone.messages = phone.messages - started_phone.messages;
+  step->phone.bytes = phone.bytes - started_phone.bytes;
+  step->phone.status_fetches = phone.status_fetches - started_phone.status_fetches;
+  return finished;
+}
+
+static void report_step(const char *name, Step *step) {
+  printf("%-24s %8u ms %10.1f us %6u msgs %8u bytes\n", name, step->ms, step->ns / 1000.0, step->phone.messages,
+         step->phone.bytes);
+}
+
+static int compare_u32(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+  return (x > y) - (x < y);
+}
+
+static uint32_t percentile(uint32_t *samples, int count, int percent) {
+  qsort(samples, count, sizeof(uint32_t), compare_u32);
+  int index = (count * percent + 99) / 100 - 1;
+  return samples[(index < 0) ? 0 : index];
+}
+
+// --- Step completion ---
+
+static bool selected_loaded(void) {
+  DeviceCacheEntry *entry = devicecache_get(g_device_selected);
+  return entry != NULL && entry->has_details && phone_stats().status_fetches > s_fetches_before;
+}
+
+static bool all_details_loaded(void) {
+  for (int i = 0; i < g_device_count; i++) {
+    if (!devicecache_get(i)->has_details) return false;
+  }
+  return true;
+}
+
+// Indicates if every device's name and location were stored (rather than blank, e.g. as the string
+// arena was full), reporting the first that was not
+static bool all_names_stored(void) {
+  for (int i = 0; i < g_device_count; i++) {
+    DeviceCacheEntry *entry = devicecache_get(i);
+    if (strarena_get(entry->name)[0] == '\0' || strarena_get(entry->location)[0] == '\0') {
+      fprintf(stderr, "fleet: device %d has no name or location\n", g_device_id_list[i]);
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool first_door_changed(void) {
+  return devicecache_get(0)->status == s_door_target;
+}
+
+// --- Session ---
+
+static bool start_step(Step *step, bool (*done)(void), void (*action)(void)) {
+  uint32_t started_ms = host_now();
+  PhoneStats started_phone = phone_stats();
+  s_fetches_before = started_phone.status_fetches;
+  uint64_t started_ns = now_ns();
+  action();
+  return run_until(done, step, started_ms, started_ns, started_phone);
+}
+
+static void connect(void) { phone_connect(); }
+static void scroll_down(void) { host_click(BUTTON_ID_DOWN, 0); }
+static void open_overview(void) { host_long_click(BUTTON_ID_SELECT); }
+static void change_status(void) { host_click(BUTTON_ID_SELECT, 0); }
+
+// Run in place of the app's event loop once the app has initialised
+static void event_loop(void) {
+  Step step;
+  size_t heap_before = host_heap_stats().used;
+  printf("fleet: %d doors, %d lights, %d gates, names of %d chars, %d ms travel, %d%% volatility\n",
+         s_fleet.doors, s_fleet.lights, s_fleet.gates, s_fleet.name_length, s_fleet.travel_ms, s_fleet.volatility);
+  fflush(stdout);
+
+  // Start up until the first card shows its status
+  if (!start_step(&step, selected_loaded, connect) || g_device_count != s_device_total) {
+    PhoneStats phone = phone_stats();
+    fprintf(stderr, "fleet: app did not load the list of %d devices (%u byte list message)\n", s_device_total,
+            phone.bytes);
+    return;
+  }
+  report_step("startup: first card", &step);
+
+  // Load the overview (the summary of every device), then go back to the cards
+  if (!start_step(&step, all_details_loaded, open_overview) || !all_names_stored()) {
+    fprintf(stderr, "fleet: overview did not load every device\n");
+    return;
+  }
+  report_step("overview: summary", &step);
+  host_click(BUTTON_ID_BACK, 0);
+  host_run_timers(1000);
+
+  // Scroll through every device one click at a time, each click waiting for the card's status
+  static uint32_t click_ms[PHONE_MAX_DEVICES];
+  static uint32_t click_us[PHONE_MAX_DEVICES];
+  Step scroll = {0};
+  for (int i = 0; i < s_device_total; i++) {
+    if (!start_step(&step, selected_loaded, scroll_down)) {
+      fprintf(stderr, "fleet: device %d did not load while scrolling\n", g_device_selected);
+      return;
+    }
+    click_ms[i] = step.ms;
+    click_us[i] = step.ns / 1000;
+    scroll.ms += step.ms;
+    scroll.ns += step.ns;
+    scroll.phone.messages += step.phone.messages;
+    scroll.phone.bytes += step.phone.bytes;
+  }
+  report_step("scroll: all devices", &scroll);
+  printf("%-24s %8u ms p50 %5u ms p95 %6u us p50 %6u us p95\n", "scroll: per click",
+         percentile(click_ms, s_device_total, 50), percentile(click_ms, s_device_total, 95),
+         percentile(click_us, s_device_total, 50), percentile(click_us, s_device_total, 95));
+
+  // Main window drawing, which shows a spot per device until there are too many
+  GContext *ctx = host_gcontext_create();
+  uint64_t started_ns = now_ns();
+  host_render_top_window(ctx);
+  HostDrawStats draw = host_gcontext_stats(ctx);
+  printf("%-24s %8.1f us %6u draws\n", "render: main window", (now_ns() - started_ns) / 1000.0, draw.ops);
+  host_gcontext_destroy(ctx);
+
+  // Open or close the first device (a door) and wait for it to finish travelling
+  if (g_device_selected == 0 && devicecache_get(0)->device_type == DTGarageDoor) {
+    s_door_target = (devicecache_get(0)->status == DSClosed) ? DSOnOpen : DSClosed;
+    if (!start_step(&step, first_door_changed, change_status)) {
+      fprintf(stderr, "fleet: door did not finish travelling\n");
+      return;
+    }
+    report_step("door: open/close", &step);
+    printf("%-24s %8u fetches\n", "door: status checks", step.phone.status_fetches);
+  }
+
+  HostHeapStats heap = host_heap_stats();
+  printf("%-24s %8d bytes in use, %d peak (of %d), %d more per device\n", "heap:", (int)heap.used,
+         (int)heap.peak_used, HOST_HEAP_SIZE, (int)(heap.peak_used - heap_before) / s_device_total);
+  printf("%-24s %8d bytes in use\n", "string arena:", (int)strarena_used());
+  s_session_ok = true;
+}
+
+int main(int argc, char *argv[]) {
+  int *settings[] = {&s_fleet.doors, &s_fleet.lights, &s_fleet.gates, &s_fleet.name_length, &s_fleet.travel_ms,
+                     &s_fleet.volatility};
+  for (int i = 1; i < argc && i <= (int)ARRAY_LENGTH(settings); i++) *settings[i - 1] = atoi(argv[i]);
+  s_device_total = s_fleet.doors + s_fleet.lights + s_fleet.gates;
+  if (s_device_total <= 0 || s_device_total > PHONE_MAX_DEVICES || s_fleet.doors <= 0) {
+    fprintf(stderr, "fleet: between 1 and %d devices are needed, starting with a door\n", PHONE_MAX_DEVICES);
+    return 1;
+  }
+
+  phone_init_fleet(&s_fleet);
+  host_set_event_loop(event_loop);
+  homep_main();
+
+  // Anything left after the app deinitialises is leaked
+  int timers = host_pending_timers();
+  host_shutdown();
+  HostHeapStats heap = host_heap_stats();
+  if (heap.used > 0 || timers > 0) {
+    fprintf(stderr, "fleet: %d bytes leaked at exit, %d timers left pending\n", (int)heap.used, timers);
+    return 1;
+  }
+  return s_session_ok ? 0 : 1;
+}
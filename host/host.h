@@ -0,0 +1,64 @@
+#pragma once
+#include <pebble.h>
+
+// Controls for the simulated SDK in pebble_host.c, used by the host tools to drive the app
+
+// Heap counters (allocations made through malloc/calloc/realloc by the app or the simulated SDK)
+typedef struct HostHeapStats {
+  uint32_t allocs;
+  uint32_t frees;
+  uint32_t bytes_allocated;
+  size_t used;
+  size_t peak_used;
+} HostHeapStats;
+
+HostHeapStats host_heap_stats(void);
+
+// Release what the SDK owns (windows left on the stack, AppMessage buffers and any timers still pending)
+// as the watch does when the app exits, so anything left on the heap afterwards has been leaked by the app
+void host_shutdown(void);
+
+// Function run in place of the SDK event loop (main() returns once it finishes)
+void host_set_event_loop(void (*event_loop)(void));
+
+// Only log messages at or below this level are printed (defaults to APP_LOG_LEVEL_ERROR)
+void host_set_log_level(AppLogLevel log_level);
+
+// Simulated clock in milliseconds. Time only moves when timers are run
+uint32_t host_now(void);
+
+// Advance the clock, first completing any outbox send and then firing timers as they fall due
+void host_run_timers(uint32_t ms);
+
+// Number of app timers (and scheduled animations) waiting to fire
+int host_pending_timers(void);
+
+// Deliver a dictionary from the "phone" to the inbox received handler
+void host_inbox_deliver(const uint8_t *buffer, uint16_t size);
+
+// Called with each dictionary the app sends once the send completes
+typedef void (*HostOutboxHandler)(DictionaryIterator *iter);
+void host_set_outbox_handler(HostOutboxHandler handler);
+
+// Press a button on the top window (repeat_count > 0 simulates a held button auto repeating)
+void host_click(ButtonId button_id, uint8_t repeat_count);
+void host_long_click(ButtonId button_id);
+
+// Fake graphics context, which counts the drawing operations made on it
+typedef struct HostDrawStats {
+  uint32_t ops;
+  uint32_t text_ops;
+  uint32_t text_chars;
+} HostDrawStats;
+
+GContext *host_gcontext_create(void);
+void host_gcontext_destroy(GContext *ctx);
+HostDrawStats host_gcontext_stats(GContext *ctx);
+void host_gcontext_reset(GContext *ctx);
+
+// Run the update procs of a layer tree (or the top window) as the compositor would
+void host_render(Layer *layer, GContext *ctx);
+void host_render_top_window(GContext *ctx);
+
+// Run the subscribed tick handler as if the given units changed
+void host_tick(TimeUnits units_changed);
@@ -0,0 +1,1563 @@
+#define HOST_IMPL
+#include <pebble.h>
+#include <stdarg.h>
+#include <math.h>
+#include "host.h"
+
+// Simulated Pebble SDK for running the watch sources on the host.
+// Behaviour follows the SDK closely enough for the app's logic (timers, window stack, clicks, layer
+// tree, AppMessage and dictionaries), but nothing is actually drawn and animations jump straight to
+// their end frame when they finish.
+
+// --- Heap ---
+
+// Per allocation overhead of the watch heap (block header)
+#define HEAP_BLOCK_OVERHEAD 8
+
+typedef struct HeapBlock {
+  size_t size;
+  size_t pad;
+} HeapBlock;
+
+static HostHeapStats s_heap;
+
+void *host_malloc(size_t size) {
+  if (s_heap.used + size + HEAP_BLOCK_OVERHEAD > HOST_HEAP_SIZE) return NULL;
+  HeapBlock *block = malloc(sizeof(HeapBlock) + size);
+  if (block == NULL) return NULL;
+  block->size = size;
+  s_heap.allocs++;
+  s_heap.bytes_allocated += size;
+  s_heap.used += size + HEAP_BLOCK_OVERHEAD;
+  if (s_heap.used > s_heap.peak_used) s_heap.peak_used = s_heap.used;
+  return block + 1;
+}
+
+void *host_calloc(size_t count, size_t size) {
+  void *ptr = host_malloc(count * size);
+  if (ptr != NULL) memset(ptr, 0, count * size);
+  return ptr;
+}
+
+void host_free(void *ptr) {
+  if (ptr == NULL) return;
+  HeapBlock *block = (HeapBlock*)ptr - 1;
+  s_heap.frees++;
+  s_heap.used -= block->size + HEAP_BLOCK_OVERHEAD;
+  free(block);
+}
+
+void *host_realloc(void *ptr, size_t size) {
+  if (ptr == NULL) return host_malloc(size);
+  HeapBlock *block = (HeapBlock*)ptr - 1;
+  void *new_ptr = host_malloc(size);
+  if (new_ptr == NULL) return NULL;
+  memcpy(new_ptr, ptr, (block->size < size) ? block->size : size);
+  host_free(ptr);
+  return new_ptr;
+}
+
+size_t heap_bytes_used(void) {
+  return s_heap.used;
+}
+
+size_t heap_bytes_free(void) {
+  return HOST_HEAP_SIZE - s_heap.used;
+}
+
+HostHeapStats host_heap_stats(void) {
+  return s_heap;
+}
+
+// --- Logging and event loop ---
+
+static AppLogLevel s_log_level = APP_LOG_LEVEL_ERROR;
+static void (*s_event_loop)(void) = NULL;
+
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number, const char *fmt, ...) {
+  if (log_level > s_log_level) return;
+  va_list args;
+  va_start(args, fmt);
+  fprintf(stderr, "[%d] %s:%d ", log_level, src_filename, src_line_number);
+  vfprintf(stderr, fmt, args);
+  fprintf(stderr, "\n");
+  va_end(args);
+}
+
+void host_set_log_level(AppLogLevel log_level) {
+  s_log_level = log_level;
+}
+
+void host_set_event_loop(void (*event_loop)(void)) {
+  s_event_loop = event_loop;
+}
+
+void app_event_loop(void) {
+  if (s_event_loop != NULL) s_event_loop();
+}
+
+void light_enable_interaction(void) {
+}
+
+void vibes_short_pulse(void) {
+}
+
+void vibes_double_pulse(void) {
+}
+
+// --- Time and app timers ---
+
+// Timers are kept in a list ordered by when they fall due and are referred to by ID (like the SDK)
+// so stale handles are harmless
+typedef struct HostTimer {
+  uintptr_t id;
+  uint32_t due;
+  AppTimerCallback callback;
+  void *data;
+  struct HostTimer *next;
+} HostTimer;
+
+static HostTimer *s_timers = NULL;
+static uintptr_t s_next_timer_id = 1;
+static uint32_t s_now = 0;
+static time_t s_epoch = 0;
+
+uint32_t host_now(void) {
+  return s_now;
+}
+
+uint16_t time_ms(time_t *t_utc, uint16_t *out_ms) {
+  if (s_epoch == 0) s_epoch = time(NULL);
+  time_t seconds = s_epoch + s_now / 1000;
+  uint16_t millis = s_now % 1000;
+  if (t_utc != NULL) *t_utc = seconds;
+  if (out_ms != NULL) *out_ms = millis;
+  return millis;
+}
+
+time_t host_time(time_t *tloc) {
+  time_t now;
+  time_ms(&now, NULL);
+  if (tloc != NULL) *tloc = now;
+  return now;
+}
+
+bool clock_is_24h_style(void) {
+  return false;
+}
+
+static void insert_timer(HostTimer *timer) {
+  HostTimer **link = &s_timers;
+  while (*link != NULL && (*link)->due <= timer->due) link = &(*link)->next;
+  timer->next = *link;
+  *link = timer;
+}
+
+static HostTimer *unlink_timer(uintptr_t id) {
+  for (HostTimer **link = &s_timers; *link != NULL; link = &(*link)->next) {
+    if ((*link)->id == id) {
+      HostTimer *timer = *link;
+      *link = timer->next;
+      return timer;
+    }
+  }
+  return NULL;
+}
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data) {
+  HostTimer *timer = host_malloc(sizeof(HostTimer));
+  if (timer == NULL) return NULL;
+  timer->id = s_next_timer_id++;
+  timer->due = s_now + timeout_ms;
+  timer->callback = callback;
+  timer->data = callback_data;
+  insert_timer(timer);
+  return (AppTimer*)timer->id;
+}
+
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms) {
+  HostTimer *timer = unlink_timer((uintptr_t)timer_handle);
+  if (timer == NULL) return false;
+  timer->due = s_now + new_timeout_ms;
+  insert_timer(timer);
+  return true;
+}
+
+void app_timer_cancel(AppTimer *timer_handle) {
+  host_free(unlink_timer((uintptr_t)timer_handle));
+}
+
+int host_pending_timers(void) {
+  int count = 0;
+  for (HostTimer *timer = s_timers; timer != NULL; timer = timer->next) count++;
+  return count;
+}
+
+static void complete_outbox_send(void);
+
+void host_run_timers(uint32_t ms) {
+  uint32_t target = s_now + ms;
+  complete_outbox_send();
+  while (s_timers != NULL && s_timers->due <= target) {
+    HostTimer *timer = s_timers;
+    s_timers = timer->next;
+    if (timer->due > s_now) s_now = timer->due;
+    AppTimerCallback callback = timer->callback;
+    void *data = timer->data;
+    host_free(timer);
+    callback(data);
+    complete_outbox_send();
+  }
+  s_now = target;
+}
+
+static TickHandler s_tick_handler = NULL;
+
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler) {
+  s_tick_handler = handler;
+}
+
+void tick_timer_service_unsubscribe(void) {
+  s_tick_handler = NULL;
+}
+
+void host_tick(TimeUnits units_changed) {
+  if (s_tick_handler == NULL) return;
+  time_t now;
+  time_ms(&now, NULL);
+  s_tick_handler(localtime(&now), units_changed);
+}
+
+// --- Geometry ---
+
+GRect grect_inset(GRect rect, int16_t inset) {
+  return GRect(rect.origin.x + inset, rect.origin.y + inset, rect.size.w - 2 * inset, rect.size.h - 2 * inset);
+}
+
+bool grect_equal(const GRect *rect_a, const GRect *rect_b) {
+  return memcmp(rect_a, rect_b, sizeof(GRect)) == 0;
+}
+
+bool gcolor_equal(GColor8 x, GColor8 y) {
+  return x.argb == y.argb;
+}
+
+int32_t sin_lookup(int32_t angle) {
+  return (int32_t)lround(sin(angle * 2 * M_PI / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+int32_t cos_lookup(int32_t angle) {
+  return (int32_t)lround(cos(angle * 2 * M_PI / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+GPoint gpoint_from_polar(GRect container, GOvalScaleMode scale_mode, int32_t angle) {
+  int16_t radius = ((container.size.w < container.size.h) ? container.size.w : container.size.h) / 2;
+  int16_t cx = container.origin.x + container.size.w / 2;
+  int16_t cy = container.origin.y + container.size.h / 2;
+  return GPoint(cx + sin_lookup(angle) * radius / TRIG_MAX_RATIO, cy - cos_lookup(angle) * radius / TRIG_MAX_RATIO);
+}
+
+GRect grect_centered_from_polar(GRect container, GOvalScaleMode scale_mode, int32_t angle, GSize size) {
+  GPoint center = gpoint_from_polar(container, scale_mode, angle);
+  return GRect(center.x - size.w / 2, center.y - size.h / 2, size.w, size.h);
+}
+
+// --- Fonts and bitmaps ---
+
+GFont fonts_get_system_font(const char *font_key) {
+  return font_key;
+}
+
+// Approximate glyph size of a system font (taken from the size in its key)
+static GSize font_glyph_size(GFont font) {
+  int size = 14;
+  const char *digits = (font != NULL) ? strpbrk(font, "0123456789") : NULL;
+  if (digits != NULL) size = atoi(digits);
+  return GSize(size / 2, size + 4);
+}
+
+struct GBitmap {
+  GRect bounds;
+  const GBitmap *parent;
+  uint8_t data[];
+};
+
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id) {
+  GSize size = (resource_id == RESOURCE_ID_IMAGE_APPICON) ? GSize(25, 25) : GSize(18, 18);
+  GBitmap *bitmap = host_malloc(sizeof(GBitmap) + size.w * size.h);
+  if (bitmap == NULL) return NULL;
+  bitmap->bounds = GRect(0, 0, size.w, size.h);
+  bitmap->parent = NULL;
+  return bitmap;
+}
+
+GBitmap *gbitmap_create_as_sub_bitmap(const GBitmap *base_bitmap, GRect sub_rect) {
+  GBitmap *bitmap = host_malloc(sizeof(GBitmap));
+  if (bitmap == NULL) return NULL;
+  bitmap->bounds = sub_rect;
+  bitmap->parent = base_bitmap;
+  return bitmap;
+}
+
+GRect gbitmap_get_bounds(const GBitmap *bitmap) {
+  return bitmap->bounds;
+}
+
+void gbitmap_destroy(GBitmap *bitmap) {
+  host_free(bitmap);
+}
+
+// --- Graphics ---
+
+struct GContext {
+  GColor fill_color;
+  GColor stroke_color;
+  GColor text_color;
+  uint8_t stroke_width;
+  GCompOp compositing_mode;
+  HostDrawStats stats;
+};
+
+GContext *host_gcontext_create(void) {
+  GContext *ctx = calloc(1, sizeof(GContext));
+  ctx->stroke_width = 1;
+  return ctx;
+}
+
+void host_gcontext_destroy(GContext *ctx) {
+  free(ctx);
+}
+
+HostDrawStats host_gcontext_stats(GContext *ctx) {
+  return ctx->stats;
+}
+
+void host_gcontext_reset(GContext *ctx) {
+  memset(&ctx->stats, 0, sizeof(ctx->stats));
+}
+
+void graphics_context_set_fill_color(GContext *ctx, GColor color) {
+  ctx->fill_color = color;
+}
+
+void graphics_context_set_stroke_color(GContext *ctx, GColor color) {
+  ctx->stroke_color = color;
+}
+
+void graphics_context_set_text_color(GContext *ctx, GColor color) {
+  ctx->text_color = color;
+}
+
+void graphics_context_set_stroke_width(GContext *ctx, uint8_t stroke_width) {
+  ctx->stroke_width = stroke_width;
+}
+
+void graphics_context_set_compositing_mode(GContext *ctx, GCompOp mode) {
+  ctx->compositing_mode = mode;
+}
+
+void graphics_draw_pixel(GContext *ctx, GPoint point) {
+  ctx->stats.ops++;
+}
+
+void graphics_draw_line(GContext *ctx, GPoint p0, GPoint p1) {
+  ctx->stats.ops++;
+}
+
+void graphics_draw_rect(GContext *ctx, GRect rect) {
+  ctx->stats.ops++;
+}
+
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, GCornerMask corner_mask) {
+  ctx->stats.ops++;
+}
+
+void graphics_draw_round_rect(GContext *ctx, GRect rect, uint16_t radius) {
+  ctx->stats.ops++;
+}
+
+void graphics_draw_circle(GContext *ctx, GPoint p, uint16_t radius) {
+  ctx->stats.ops++;
+}
+
+void graphics_fill_circle(GContext *ctx, GPoint p, uint16_t radius) {
+  ctx->stats.ops++;
+}
+
+void graphics_draw_arc(GContext *ctx, GRect rect, GOvalScaleMode scale_mode, int32_t angle_start, int32_t angle_end) {
+  ctx->stats.ops++;
+}
+
+void graphics_fill_radial(GContext *ctx, GRect rect, GOvalScaleMode scale_mode, uint16_t inset_thickness,
+                          int32_t angle_start, int32_t angle_end) {
+  ctx->stats.ops++;
+}
+
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect) {
+  ctx->stats.ops++;
+}
+
+void graphics_draw_text(GContext *ctx, const char *text, GFont const font, const GRect box,
+                        const GTextOverflowMode overflow_mode, const GTextAlignment alignment, void *layout) {
+  ctx->stats.ops++;
+  ctx->stats.text_ops++;
+  if (text != NULL) ctx->stats.text_chars += strlen(text);
+}
+
+GSize graphics_text_layout_get_content_size(const char *text, GFont const font, const GRect box,
+                                            const GTextOverflowMode overflow_mode, const GTextAlignment alignment) {
+  if (text == NULL || text[0] == '\0') return GSizeZero;
+  GSize glyph = font_glyph_size(font);
+  int per_line = (box.size.w > glyph.w) ? box.size.w / glyph.w : 1;
+  int width = 0;
+  int lines = 1;
+  int column = 0;
+  for (const char *c = text; *c != '\0'; c++) {
+    if (*c == '\n' || column == per_line) {
+      lines++;
+      column = 0;
+      if (*c == '\n') continue;
+    }
+    column++;
+    if (column * glyph.w > width) width = column * glyph.w;
+  }
+  int height = lines * glyph.h;
+  if (overflow_mode != GTextOverflowModeWordWrap && height > box.size.h) height = box.size.h;
+  return GSize(width, height);
+}
+
+// --- Layers ---
+
+struct Layer {
+  GRect frame;
+  GRect bounds;
+  bool hidden;
+  Layer *parent;
+  Layer *first_child;
+  Layer *next_sibling;
+  Window *window;
+  LayerUpdateProc update_proc;
+  void *data;
+} __attribute__((aligned(8)));
+
+void layer_remove_from_parent(Layer *child);
+
+static void layer_init(Layer *layer, GRect frame) {
+  memset(layer, 0, sizeof(Layer));
+  layer->frame = frame;
+  layer->bounds = GRect(0, 0, frame.size.w, frame.size.h);
+}
+
+// Remove a layer from the tree (children are orphaned rather than destroyed, as on the watch)
+static void layer_deinit(Layer *layer) {
+  layer_remove_from_parent(layer);
+  while (layer->first_child != NULL) layer_remove_from_parent(layer->first_child);
+}
+
+Layer *layer_create_with_data(GRect frame, size_t data_size) {
+  Layer *layer = host_calloc(1, sizeof(Layer) + data_size);
+  if (layer == NULL) return NULL;
+  layer_init(layer, frame);
+  if (data_size > 0) layer->data = layer + 1;
+  return layer;
+}
+
+Layer *layer_create(GRect frame) {
+  return layer_create_with_data(frame, 0);
+}
+
+void layer_remove_from_parent(Layer *child) {
+  if (child == NULL || child->parent == NULL) return;
+  for (Layer **link = &child->parent->first_child; *link != NULL; link = &(*link)->next_sibling) {
+    if (*link == child) {
+      *link = child->next_sibling;
+      break;
+    }
+  }
+  child->parent = NULL;
+  child->next_sibling = NULL;
+}
+
+void layer_destroy(Layer *layer) {
+  if (layer == NULL) return;
+  layer_deinit(layer);
+  host_free(layer);
+}
+
+void layer_add_child(Layer *parent, Layer *child) {
+  layer_remove_from_parent(child);
+  Layer **link = &parent->first_child;
+  while (*link != NULL) link = &(*link)->next_sibling;
+  *link = child;
+  child->parent = parent;
+}
+
+void layer_mark_dirty(Layer *layer) {
+}
+
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc) {
+  layer->update_proc = update_proc;
+}
+
+void layer_set_frame(Layer *layer, GRect frame) {
+  layer->frame = frame;
+  layer->bounds.size = frame.size;
+}
+
+GRect layer_get_frame(const Layer *layer) {
+  return layer->frame;
+}
+
+void layer_set_bounds(Layer *layer, GRect bounds) {
+  layer->bounds = bounds;
+}
+
+GRect layer_get_bounds(const Layer *layer) {
+  return layer->bounds;
+}
+
+GRect layer_get_unobstructed_bounds(const Layer *layer) {
+  return layer->bounds;
+}
+
+Window *layer_get_window(const Layer *layer) {
+  while (layer->parent != NULL) layer = layer->parent;
+  return layer->window;
+}
+
+void layer_set_hidden(Layer *layer, bool hidden) {
+  layer->hidden = hidden;
+}
+
+bool layer_get_hidden(const Layer *layer) {
+  return layer->hidden;
+}
+
+void *layer_get_data(const Layer *layer) {
+  return layer->data;
+}
+
+void host_render(Layer *layer, GContext *ctx) {
+  if (layer == NULL || layer->hidden) return;
+  if (layer->update_proc != NULL) layer->update_proc(layer, ctx);
+  for (Layer *child = layer->first_child; child != NULL; child = child->next_sibling)
+    host_render(child, ctx);
+}
+
+// Standard layers start with their Layer (so the app can cast them to a Layer, as the SDK allows)
+
+struct TextLayer {
+  Layer layer;
+  const char *text;
+  GFont font;
+  GColor background_color;
+  GColor text_color;
+  GTextAlignment alignment;
+  GTextOverflowMode overflow_mode;
+};
+
+static void text_layer_update_proc(Layer *layer, GContext *ctx) {
+  TextLayer *text_layer = (TextLayer*)layer;
+  if (text_layer->background_color.argb != GColorClear.argb) {
+    graphics_context_set_fill_color(ctx, text_layer->background_color);
+    graphics_fill_rect(ctx, layer->bounds, 0, GCornerNone);
+  }
+  if (text_layer->text != NULL) {
+    graphics_context_set_text_color(ctx, text_layer->text_color);
+    graphics_draw_text(ctx, text_layer->text, text_layer->font, layer->bounds, text_layer->overflow_mode,
+                       text_layer->alignment, NULL);
+  }
+}
+
+TextLayer *text_layer_create(GRect frame) {
+  TextLayer *text_layer = host_calloc(1, sizeof(TextLayer));
+  if (text_layer == NULL) return NULL;
+  layer_init(&text_layer->layer, frame);
+  layer_set_update_proc(&text_layer->layer, text_layer_update_proc);
+  text_layer->font = fonts_get_system_font(FONT_KEY_GOTHIC_14);
+  text_layer->background_color = GColorWhite;
+  text_layer->text_color = GColorBlack;
+  text_layer->overflow_mode = GTextOverflowModeWordWrap;
+  return text_layer;
+}
+
+void text_layer_destroy(TextLayer *text_layer) {
+  if (text_layer == NULL) return;
+  layer_deinit(&text_layer->layer);
+  host_free(text_layer);
+}
+
+Layer *text_layer_get_layer(TextLayer *text_layer) {
+  return &text_layer->layer;
+}
+
+void text_layer_set_text(TextLayer *text_layer, const char *text) {
+  text_layer->text = text;
+}
+
+const char *text_layer_get_text(TextLayer *text_layer) {
+  return text_layer->text;
+}
+
+void text_layer_set_background_color(TextLayer *text_layer, GColor color) {
+  text_layer->background_color = color;
+}
+
+void text_layer_set_text_color(TextLayer *text_layer, GColor color) {
+  text_layer->text_color = color;
+}
+
+void text_layer_set_font(TextLayer *text_layer, GFont font) {
+  text_layer->font = font;
+}
+
+void text_layer_set_text_alignment(TextLayer *text_layer, GTextAlignment text_alignment) {
+  text_layer->alignment = text_alignment;
+}
+
+void text_layer_set_overflow_mode(TextLayer *text_layer, GTextOverflowMode line_mode) {
+  text_layer->overflow_mode = line_mode;
+}
+
+GSize text_layer_get_content_size(TextLayer *text_layer) {
+  return graphics_text_layout_get_content_size(text_layer->text, text_layer->font, text_layer->layer.bounds,
+                                               text_layer->overflow_mode, text_layer->alignment);
+}
+
+void text_layer_enable_screen_text_flow_and_paging(TextLayer *text_layer, uint8_t inset) {
+}
+
+// --- Windows and clicks ---
+
+typedef struct ClickConfig {
+  ClickHandler single;
+  uint16_t repeat_interval_ms;
+  ClickHandler long_down;
+  ClickHandler long_up;
+} ClickConfig;
+
+struct Window {
+  Layer *root_layer;
+  WindowHandlers handlers;
+  ClickConfigProvider click_config_provider;
+  void *click_config_context;
+  ClickConfig click_config[NUM_BUTTONS];
+  GColor background_color;
+  void *user_data;
+  bool loaded;
+};
+
+typedef struct HostClickRecognizer {
+  ButtonId button_id;
+  uint8_t clicks;
+  bool repeating;
+} HostClickRecognizer;
+
+#define WINDOW_STACK_SIZE 8
+static Window *s_window_stack[WINDOW_STACK_SIZE];
+static int s_window_count = 0;
+static Window *s_configuring_window = NULL;
+
+static void window_root_update_proc(Layer *layer, GContext *ctx) {
+  Window *window = layer->window;
+  if (window->background_color.argb != GColorClear.argb) {
+    graphics_context_set_fill_color(ctx, window->background_color);
+    graphics_fill_rect(ctx, layer->bounds, 0, GCornerNone);
+  }
+}
+
+Window *window_create(void) {
+  Window *window = host_calloc(1, sizeof(Window));
+  if (window == NULL) return NULL;
+  window->root_layer = layer_create(GRect(0, 0, PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT));
+  window->root_layer->window = window;
+  layer_set_update_proc(window->root_layer, window_root_update_proc);
+  window->background_color = GColorWhite;
+  return window;
+}
+
+void window_destroy(Window *window) {
+  if (window == NULL) return;
+  window_stack_remove(window, false);
+  layer_destroy(window->root_layer);
+  host_free(window);
+}
+
+void window_set_click_config_provider_with_context(Window *window, ClickConfigProvider click_config_provider,
+                                                   void *context) {
+  window->click_config_provider = click_config_provider;
+  window->click_config_context = context;
+}
+
+void window_set_click_config_provider(Window *window, ClickConfigProvider click_config_provider) {
+  window_set_click_config_provider_with_context(window, click_config_provider, NULL);
+}
+
+void window_set_window_handlers(Window *window, WindowHandlers handlers) {
+  window->handlers = handlers;
+}
+
+void window_set_background_color(Window *window, GColor background_color) {
+  window->background_color = background_color;
+}
+
+Layer *window_get_root_layer(const Window *window) {
+  return window->root_layer;
+}
+
+void window_set_user_data(Window *window, void *data) {
+  window->user_data = data;
+}
+
+void *window_get_user_data(const Window *window) {
+  return window->user_data;
+}
+
+void window_single_click_subscribe(ButtonId button_id, ClickHandler handler) {
+  if (s_configuring_window == NULL) return;
+  s_configuring_window->click_config[button_id].single = handler;
+  s_configuring_window->click_config[button_id].repeat_interval_ms = 0;
+}
+
+void window_single_repeating_click_subscribe(ButtonId button_id, uint16_t repeat_interval_ms, ClickHandler handler) {
+  if (s_configuring_window == NULL) return;
+  s_configuring_window->click_config[button_id].single = handler;
+  s_configuring_window->click_config[button_id].repeat_interval_ms = repeat_interval_ms;
+}
+
+void window_long_click_subscribe(ButtonId button_id, uint16_t delay_ms, ClickHandler down_handler,
+                                 ClickHandler up_handler) {
+  if (s_configuring_window == NULL) return;
+  s_configuring_window->click_config[button_id].long_down = down_handler;
+  s_configuring_window->click_config[button_id].long_up = up_handler;
+}
+
+uint8_t click_number_of_clicks_counted(ClickRecognizerRef recognizer) {
+  return ((HostClickRecognizer*)recognizer)->clicks;
+}
+
+bool click_recognizer_is_repeating(ClickRecognizerRef recognizer) {
+  return ((HostClickRecognizer*)recognizer)->repeating;
+}
+
+ButtonId click_recognizer_get_button_id(ClickRecognizerRef recognizer) {
+  return ((HostClickRecognizer*)recognizer)->button_id;
+}
+
+// Set up the clicks of a window that has become the top of the stack
+static void configure_clicks(Window *window) {
+  memset(window->click_config, 0, sizeof(window->click_config));
+  if (window->click_config_provider != NULL) {
+    s_configuring_window = window;
+    window->click_config_provider(window->click_config_context);
+    s_configuring_window = NULL;
+  }
+}
+
+static void window_appeared(Window *window) {
+  if (!window->loaded) {
+    window->loaded = true;
+    if (window->handlers.load != NULL) window->handlers.load(window);
+  }
+  configure_clicks(window);
+  if (window->handlers.appear != NULL) window->handlers.appear(window);
+}
+
+// Take a window off the stack. The window can be destroyed by its unload handler so it is not
+// touched afterwards
+static void window_removed(Window *window, bool was_top) {
+  if (was_top && window->handlers.disappear != NULL) window->handlers.disappear(window);
+  window->loaded = false;
+  if (window->handlers.unload != NULL) window->handlers.unload(window);
+}
+
+void window_stack_push(Window *window, bool animated) {
+  if (window_stack_contains_window(window)) window_stack_remove(window, false);
+  if (s_window_count == WINDOW_STACK_SIZE) return;
+  Window *top = window_stack_get_top_window();
+  if (top != NULL && top->handlers.disappear != NULL) top->handlers.disappear(top);
+  s_window_stack[s_window_count++] = window;
+  window_appeared(window);
+}
+
+bool window_stack_remove(Window *window, bool animated) {
+  for (int i = 0; i < s_window_count; i++) {
+    if (s_window_stack[i] == window) {
+      bool was_top = (i == s_window_count - 1);
+      memmove(&s_window_stack[i], &s_window_stack[i + 1], (s_window_count - i - 1) * sizeof(Window*));
+      s_window_count--;
+      window_removed(window, was_top);
+      if (was_top && s_window_count > 0) {
+        Window *top = s_window_stack[s_window_count - 1];
+        configure_clicks(top);
+        if (top->handlers.appear != NULL) top->handlers.appear(top);
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+Window *window_stack_pop(bool animated) {
+  Window *top = window_stack_get_top_window();
+  if (top != NULL) window_stack_remove(top, animated);
+  return top;
+}
+
+void window_stack_pop_all(const bool animated) {
+  while (s_window_count > 0) {
+    Window *top = s_window_stack[--s_window_count];
+    window_removed(top, true);
+  }
+}
+
+Window *window_stack_get_top_window(void) {
+  return (s_window_count > 0) ? s_window_stack[s_window_count - 1] : NULL;
+}
+
+bool window_stack_contains_window(Window *window) {
+  for (int i = 0; i < s_window_count; i++)
+    if (s_window_stack[i] == window) return true;
+  return false;
+}
+
+void host_click(ButtonId button_id, uint8_t repeat_count) {
+  Window *window = window_stack_get_top_window();
+  if (window == NULL) return;
+  ClickConfig *config = &window->click_config[button_id];
+  if (config->single == NULL) {
+    if (button_id == BUTTON_ID_BACK) window_stack_pop(true);
+    return;
+  }
+  if (repeat_count > 0 && config->repeat_interval_ms == 0) return;
+  HostClickRecognizer recognizer = {button_id, repeat_count + 1, repeat_count > 0};
+  config->single(&recognizer, window->click_config_context);
+}
+
+void host_long_click(ButtonId button_id) {
+  Window *window = window_stack_get_top_window();
+  if (window == NULL) return;
+  ClickConfig *config = &window->click_config[button_id];
+  HostClickRecognizer recognizer = {button_id, 1, false};
+  if (config->long_down != NULL) config->long_down(&recognizer, window->click_config_context);
+  if (config->long_up != NULL) config->long_up(&recognizer, window->click_config_context);
+}
+
+void host_render_top_window(GContext *ctx) {
+  Window *window = window_stack_get_top_window();
+  if (window != NULL) host_render(window->root_layer, ctx);
+}
+
+// --- Standard layers ---
+
+struct ActionBarLayer {
+  Layer layer;
+  const GBitmap *icons[NUM_BUTTONS];
+  ClickConfigProvider click_config_provider;
+  void *context;
+  GColor background_color;
+  Window *window;
+};
+
+static void action_bar_update_proc(Layer *layer, GContext *ctx) {
+  ActionBarLayer *action_bar = (ActionBarLayer*)layer;
+  graphics_context_set_fill_color(ctx, action_bar->background_color);
+  graphics_fill_rect(ctx, layer->bounds, 0, GCornerNone);
+  for (int i = 0; i < NUM_BUTTONS; i++)
+    if (action_bar->icons[i] != NULL) graphics_draw_bitmap_in_rect(ctx, action_bar->icons[i], layer->bounds);
+}
+
+ActionBarLayer *action_bar_layer_create(void) {
+  ActionBarLayer *action_bar = host_calloc(1, sizeof(ActionBarLayer));
+  if (action_bar == NULL) return NULL;
+  layer_init(&action_bar->layer, GRect(PBL_DISPLAY_WIDTH - ACTION_BAR_WIDTH, 0, ACTION_BAR_WIDTH, PBL_DISPLAY_HEIGHT));
+  layer_set_update_proc(&action_bar->layer, action_bar_update_proc);
+  action_bar->background_color = GColorBlack;
+  return action_bar;
+}
+
+void action_bar_layer_destroy(ActionBarLayer *action_bar) {
+  if (action_bar == NULL) return;
+  layer_deinit(&action_bar->layer);
+  host_free(action_bar);
+}
+
+Layer *action_bar_layer_get_layer(ActionBarLayer *action_bar) {
+  return &action_bar->layer;
+}
+
+// (The click config provider of the window the action bar is on follows the action bar's)
+void action_bar_layer_set_context(ActionBarLayer *action_bar, void *context) {
+  action_bar->context = context;
+  if (action_bar->window != NULL)
+    window_set_click_config_provider_with_context(action_bar->window, action_bar->click_config_provider, context);
+}
+
+void action_bar_layer_set_click_config_provider(ActionBarLayer *action_bar, ClickConfigProvider click_config_provider) {
+  action_bar->click_config_provider = click_config_provider;
+  if (action_bar->window != NULL)
+    window_set_click_config_provider_with_context(action_bar->window, click_config_provider, action_bar->context);
+}
+
+void action_bar_layer_set_icon(ActionBarLayer *action_bar, ButtonId button_id, const GBitmap *icon) {
+  action_bar->icons[button_id] = icon;
+}
+
+void action_bar_layer_add_to_window(ActionBarLayer *action_bar, struct Window *window) {
+  layer_add_child(window->root_layer, &action_bar->layer);
+  action_bar->window = window;
+  window_set_click_config_provider_with_context(window, action_bar->click_config_provider, action_bar->context);
+}
+
+void action_bar_layer_set_background_color(ActionBarLayer *action_bar, GColor background_color) {
+  action_bar->background_color = background_color;
+}
+
+struct StatusBarLayer {
+  Layer layer;
+  GColor background;
+  GColor foreground;
+};
+
+static void status_bar_update_proc(Layer *layer, GContext *ctx) {
+  StatusBarLayer *status_bar = (StatusBarLayer*)layer;
+  graphics_context_set_fill_color(ctx, status_bar->background);
+  graphics_fill_rect(ctx, layer->bounds, 0, GCornerNone);
+  graphics_context_set_text_color(ctx, status_bar->foreground);
+  graphics_draw_text(ctx, "12:00", fonts_get_system_font(FONT_KEY_GOTHIC_14), layer->bounds,
+                     GTextOverflowModeTrailingEllipsis, GTextAlignmentCenter, NULL);
+}
+
+StatusBarLayer *status_bar_layer_create(void) {
+  StatusBarLayer *status_bar = host_calloc(1, sizeof(StatusBarLayer));
+  if (status_bar == NULL) return NULL;
+  layer_init(&status_bar->layer, GRect(0, 0, PBL_DISPLAY_WIDTH, STATUS_BAR_LAYER_HEIGHT));
+  layer_set_update_proc(&status_bar->layer, status_bar_update_proc);
+  status_bar->background = GColorBlack;
+  status_bar->foreground = GColorWhite;
+  return status_bar;
+}
+
+void status_bar_layer_destroy(StatusBarLayer *status_bar_layer) {
+  if (status_bar_layer == NULL) return;
+  layer_deinit(&status_bar_layer->layer);
+  host_free(status_bar_layer);
+}
+
+Layer *status_bar_layer_get_layer(StatusBarLayer *status_bar_layer) {
+  return &status_bar_layer->layer;
+}
+
+void status_bar_layer_set_colors(StatusBarLayer *status_bar_layer, GColor background, GColor foreground) {
+  status_bar_layer->background = background;
+  status_bar_layer->foreground = foreground;
+}
+
+struct ScrollLayer {
+  Layer layer;
+  Layer content_layer;
+};
+
+ScrollLayer *scroll_layer_create(GRect frame) {
+  ScrollLayer *scroll_layer = host_calloc(1, sizeof(ScrollLayer));
+  if (scroll_layer == NULL) return NULL;
+  layer_init(&scroll_layer->layer, frame);
+  layer_init(&scroll_layer->content_layer, GRect(0, 0, frame.size.w, frame.size.h));
+  layer_add_child(&scroll_layer->layer, &scroll_layer->content_layer);
+  return scroll_layer;
+}
+
+void scroll_layer_destroy(ScrollLayer *scroll_layer) {
+  if (scroll_layer == NULL) return;
+  layer_deinit(&scroll_layer->content_layer);
+  layer_deinit(&scroll_layer->layer);
+  host_free(scroll_layer);
+}
+
+Layer *scroll_layer_get_layer(const ScrollLayer *scroll_layer) {
+  return (Layer*)&scroll_layer->layer;
+}
+
+void scroll_layer_add_child(ScrollLayer *scroll_layer, Layer *child) {
+  layer_add_child(&scroll_layer->content_layer, child);
+}
+
+void scroll_layer_set_click_config_onto_window(ScrollLayer *scroll_layer, struct Window *window) {
+}
+
+void scroll_layer_set_content_size(ScrollLayer *scroll_layer, GSize size) {
+  layer_set_frame(&scroll_layer->content_layer, GRect(0, 0, size.w, size.h));
+}
+
+void scroll_layer_set_shadow_hidden(ScrollLayer *scroll_layer, bool hidden) {
+}
+
+// Menus draw their visible cells through a single reusable cell layer
+
+struct MenuLayer {
+  Layer layer;
+  Layer cell_layer;
+  MenuLayerCallbacks callbacks;
+  void *callback_context;
+  MenuIndex selected;
+  GColor highlight_background;
+  GColor highlight_foreground;
+};
+
+static int16_t menu_header_height(MenuLayer *menu_layer, uint16_t section) {
+  return (menu_layer->callbacks.get_header_height != NULL) ?
+    menu_layer->callbacks.get_header_height(menu_layer, section, menu_layer->callback_context) : 0;
+}
+
+static int16_t menu_cell_height(MenuLayer *menu_layer, MenuIndex *index) {
+  return (menu_layer->callbacks.get_cell_height != NULL) ?
+    menu_layer->callbacks.get_cell_height(menu_layer, index, menu_layer->callback_context) : MENU_CELL_BASIC_CELL_HEIGHT;
+}
+
+static uint16_t menu_num_sections(MenuLayer *menu_layer) {
+  return (menu_layer->callbacks.get_num_sections != NULL) ?
+    menu_layer->callbacks.get_num_sections(menu_layer, menu_layer->callback_context) : 1;
+}
+
+static uint16_t menu_num_rows(MenuLayer *menu_layer, uint16_t section) {
+  return (menu_layer->callbacks.get_num_rows != NULL) ?
+    menu_layer->callbacks.get_num_rows(menu_layer, section, menu_layer->callback_context) : 0;
+}
+
+static void menu_layer_update_proc(Layer *layer, GContext *ctx) {
+  MenuLayer *menu_layer = (MenuLayer*)layer;
+  int16_t height = layer->bounds.size.h;
+
+  // Scroll so that the selected row is on screen
+  int16_t y = 0;
+  int16_t selected_y = 0;
+  uint16_t sections = menu_num_sections(menu_layer);
+  for (uint16_t s = 0; s < sections; s++) {
+    y += menu_header_height(menu_layer, s);
+    for (uint16_t r = 0; r < menu_num_rows(menu_layer, s); r++) {
+      MenuIndex index = {s, r};
+      if (s == menu_layer->selected.section && r == menu_layer->selected.row) selected_y = y;
+      y += menu_cell_height(menu_layer, &index);
+    }
+  }
+  int16_t offset = (selected_y > height / 2) ? selected_y - height / 2 : 0;
+
+  y = -offset;
+  for (uint16_t s = 0; s < sections && y < height; s++) {
+    int16_t header_height = menu_header_height(menu_layer, s);
+    if (header_height > 0 && y + header_height > 0 && menu_layer->callbacks.draw_header != NULL) {
+      layer_set_frame(&menu_layer->cell_layer, GRect(0, y, layer->bounds.size.w, header_height));
+      menu_layer->callbacks.draw_header(ctx, &menu_layer->cell_layer, s, menu_layer->callback_context);
+    }
+    y += header_height;
+    for (uint16_t r = 0; r < menu_num_rows(menu_layer, s) && y < height; r++) {
+      MenuIndex index = {s, r};
+      int16_t cell_height = menu_cell_height(menu_layer, &index);
+      if (y + cell_height > 0 && menu_layer->callbacks.draw_row != NULL) {
+        layer_set_frame(&menu_layer->cell_layer, GRect(0, y, layer->bounds.size.w, cell_height));
+        menu_layer->cell_layer.hidden = (s == menu_layer->selected.section && r == menu_layer->selected.row);
+        menu_layer->callbacks.draw_row(ctx, &menu_layer->cell_layer, &index, menu_layer->callback_context);
+        menu_layer->cell_layer.hidden = false;
+      }
+      y += cell_height;
+    }
+  }
+}
+
+MenuLayer *menu_layer_create(GRect frame) {
+  MenuLayer *menu_layer = host_calloc(1, sizeof(MenuLayer));
+  if (menu_layer == NULL) return NULL;
+  layer_init(&menu_layer->layer, frame);
+  layer_set_update_proc(&menu_layer->layer, menu_layer_update_proc);
+  layer_init(&menu_layer->cell_layer, GRectZero);
+  return menu_layer;
+}
+
+void menu_layer_destroy(MenuLayer *menu_layer) {
+  if (menu_layer == NULL) return;
+  layer_deinit(&menu_layer->layer);
+  host_free(menu_layer);
+}
+
+Layer *menu_layer_get_layer(const MenuLayer *menu_layer) {
+  return (Layer*)&menu_layer->layer;
+}
+
+void menu_layer_set_callbacks(MenuLayer *menu_layer, void *callback_context, MenuLayerCallbacks callbacks) {
+  menu_layer->callbacks = callbacks;
+  menu_layer->callback_context = callback_context;
+}
+
+// Menu click handlers find the menu from the window's click context
+static void menu_select_handler(ClickRecognizerRef recognizer, void *context) {
+  MenuLayer *menu_layer = context;
+  if (menu_layer->callbacks.select_click != NULL)
+    menu_layer->callbacks.select_click(menu_layer, &menu_layer->selected, menu_layer->callback_context);
+}
+
+static void menu_up_handler(ClickRecognizerRef recognizer, void *context) {
+  MenuLayer *menu_layer = context;
+  MenuIndex *selected = &menu_layer->selected;
+  if (selected->row > 0) {
+    selected->row--;
+  } else {
+    while (selected->section > 0) {
+      selected->section--;
+      uint16_t rows = menu_num_rows(menu_layer, selected->section);
+      if (rows > 0) {
+        selected->row = rows - 1;
+        break;
+      }
+    }
+  }
+}
+
+static void menu_down_handler(ClickRecognizerRef recognizer, void *context) {
+  MenuLayer *menu_layer = context;
+  MenuIndex *selected = &menu_layer->selected;
+  if (selected->row + 1 < menu_num_rows(menu_layer, selected->section)) {
+    selected->row++;
+  } else {
+    uint16_t sections = menu_num_sections(menu_layer);
+    for (uint16_t s = selected->section + 1; s < sections; s++) {
+      if (menu_num_rows(menu_layer, s) > 0) {
+        selected->section = s;
+        selected->row = 0;
+        break;
+      }
+    }
+  }
+}
+
+static void menu_click_config_provider(void *context) {
+  window_single_click_subscribe(BUTTON_ID_SELECT, menu_select_handler);
+  window_single_repeating_click_subscribe(BUTTON_ID_UP, 100, menu_up_handler);
+  window_single_repeating_click_subscribe(BUTTON_ID_DOWN, 100, menu_down_handler);
+}
+
+void menu_layer_set_click_config_onto_window(MenuLayer *menu_layer, struct Window *window) {
+  window_set_click_config_provider_with_context(window, menu_click_config_provider, menu_layer);
+}
+
+void menu_layer_reload_data(MenuLayer *menu_layer) {
+  uint16_t sections = menu_num_sections(menu_layer);
+  if (menu_layer->selected.section >= sections ||
+      menu_layer->selected.row >= menu_num_rows(menu_layer, menu_layer->selected.section)) {
+    menu_layer->selected = (MenuIndex){0, 0};
+  }
+}
+
+void menu_layer_set_selected_index(MenuLayer *menu_layer, MenuIndex index, MenuRowAlign scroll_align, bool animated) {
+  menu_layer->selected = index;
+}
+
+MenuIndex menu_layer_get_selected_index(const MenuLayer *menu_layer) {
+  return menu_layer->selected;
+}
+
+void menu_layer_set_highlight_colors(MenuLayer *menu_layer, GColor background, GColor foreground) {
+  menu_layer->highlight_background = background;
+  menu_layer->highlight_foreground = foreground;
+}
+
+void menu_cell_basic_draw(GContext *ctx, const Layer *cell_layer, const char *title, const char *subtitle, GBitmap *icon) {
+  if (title != NULL)
+    graphics_draw_text(ctx, title, fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD), cell_layer->frame,
+                       GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+  if (subtitle != NULL)
+    graphics_draw_text(ctx, subtitle, fonts_get_system_font(FONT_KEY_GOTHIC_18), cell_layer->frame,
+                       GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+  if (icon != NULL) graphics_draw_bitmap_in_rect(ctx, icon, cell_layer->frame);
+}
+
+void menu_cell_basic_header_draw(GContext *ctx, const Layer *cell_layer, const char *title) {
+  if (title != NULL)
+    graphics_draw_text(ctx, title, fonts_get_system_font(FONT_KEY_GOTHIC_14_BOLD), cell_layer->frame,
+                       GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+}
+
+// (The menu marks the selected cell by hiding the shared cell layer while it is drawn)
+bool menu_cell_layer_is_highlighted(const Layer *cell_layer) {
+  return cell_layer->hidden;
+}
+
+// --- Animations ---
+
+// Only property animations of layer frames are used, which jump to their end frame when they finish.
+// As on SDK 3, animations are destroyed once they have stopped
+struct Animation {
+  uint32_t duration;
+  uint32_t delay;
+  AnimationCurve curve;
+  AnimationHandlers handlers;
+  void *context;
+  AppTimer *timer;
+};
+
+struct PropertyAnimation {
+  Animation animation;
+  Layer *layer;
+  GRect from;
+  GRect to;
+};
+
+static void animation_stop(PropertyAnimation *property_animation, bool finished) {
+  Animation *animation = &property_animation->animation;
+  animation->timer = NULL;
+  if (finished) layer_set_frame(property_animation->layer, property_animation->to);
+  if (animation->handlers.stopped != NULL) animation->handlers.stopped(animation, finished, animation->context);
+  host_free(property_animation);
+}
+
+static void animation_finished(void *data) {
+  animation_stop(data, true);
+}
+
+bool animation_set_duration(Animation *animation, uint32_t duration_ms) {
+  animation->duration = duration_ms;
+  return true;
+}
+
+bool animation_set_delay(Animation *animation, uint32_t delay_ms) {
+  animation->delay = delay_ms;
+  return true;
+}
+
+bool animation_set_curve(Animation *animation, AnimationCurve curve) {
+  animation->curve = curve;
+  return true;
+}
+
+bool animation_set_handlers(Animation *animation, AnimationHandlers callbacks, void *context) {
+  animation->handlers = callbacks;
+  animation->context = context;
+  return true;
+}
+
+bool animation_schedule(Animation *animation) {
+  PropertyAnimation *property_animation = (PropertyAnimation*)animation;
+  if (animation->timer != NULL) return false;
+  layer_set_frame(property_animation->layer, property_animation->from);
+  animation->timer = app_timer_register(animation->delay + animation->duration, animation_finished, animation);
+  if (animation->handlers.started != NULL) animation->handlers.started(animation, animation->context);
+  return true;
+}
+
+bool animation_unschedule(Animation *animation) {
+  if (animation == NULL || animation->timer == NULL) return false;
+  app_timer_cancel(animation->timer);
+  animation_stop((PropertyAnimation*)animation, false);
+  return true;
+}
+
+bool animation_is_scheduled(Animation *animation) {
+  return animation->timer != NULL;
+}
+
+PropertyAnimation *property_animation_create_layer_frame(struct Layer *layer, GRect *from_frame, GRect *to_frame) {
+  PropertyAnimation *property_animation = host_calloc(1, sizeof(PropertyAnimation));
+  if (property_animation == NULL) return NULL;
+  property_animation->animation.duration = 250;
+  property_animation->layer = layer;
+  property_animation->from = (from_frame != NULL) ? *from_frame : layer->frame;
+  property_animation->to = (to_frame != NULL) ? *to_frame : layer->frame;
+  return property_animation;
+}
+
+void property_animation_destroy(PropertyAnimation *property_animation) {
+  if (property_animation == NULL) return;
+  if (property_animation->animation.timer != NULL) app_timer_cancel(property_animation->animation.timer);
+  host_free(property_animation);
+}
+
+Animation *property_animation_get_animation(PropertyAnimation *property_animation) {
+  return &property_animation->animation;
+}
+
+// --- Dictionaries ---
+
+// Serialized as on the watch: a count byte followed by packed tuples
+struct __attribute__((__packed__)) Dictionary {
+  uint8_t count;
+  Tuple head[];
+};
+
+static Tuple *next_tuple(Tuple *tuple) {
+  return (Tuple*)((uint8_t*)tuple + sizeof(Tuple) + tuple->length);
+}
+
+DictionaryResult dict_write_begin(DictionaryIterator *iter, uint8_t *const buffer, const uint16_t size) {
+  if (iter == NULL || buffer == NULL || size < sizeof(Dictionary)) return DICT_INVALID_ARGS;
+  iter->dictionary = (Dictionary*)buffer;
+  iter->dictionary->count = 0;
+  iter->end = buffer + size;
+  iter->cursor = iter->dictionary->head;
+  return DICT_OK;
+}
+
+static DictionaryResult write_tuple(DictionaryIterator *iter, uint32_t key, TupleType type, const void *data,
+                                    uint16_t length) {
+  if (iter == NULL || iter->cursor == NULL) return DICT_INVALID_ARGS;
+  if ((uint8_t*)iter->cursor + sizeof(Tuple) + length > (uint8_t*)iter->end) return DICT_NOT_ENOUGH_STORAGE;
+  iter->cursor->key = key;
+  iter->cursor->type = type;
+  iter->cursor->length = length;
+  if (length > 0) memcpy(iter->cursor->value->data, data, length);
+  iter->cursor = next_tuple(iter->cursor);
+  iter->dictionary->count++;
+  return DICT_OK;
+}
+
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key, const uint8_t *const data,
+                                 const uint16_t size) {
+  return write_tuple(iter, key, TUPLE_BYTE_ARRAY, data, size);
+}
+
+DictionaryResult dict_write_cstring(DictionaryIterator *iter, const uint32_t key, const char *const cstring) {
+  return write_tuple(iter, key, TUPLE_CSTRING, cstring, (cstring != NULL) ? strlen(cstring) + 1 : 0);
+}
+
+DictionaryResult dict_write_int(DictionaryIterator *iter, const uint32_t key, const void *integer,
+                                const uint8_t width_bytes, const bool is_signed) {
+  if (width_bytes != 1 && width_bytes != 2 && width_bytes != 4) return DICT_INVALID_ARGS;
+  return write_tuple(iter, key, is_signed ? TUPLE_INT : TUPLE_UINT, integer, width_bytes);
+}
+
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, const uint32_t key, const uint8_t value) {
+  return dict_write_int(iter, key, &value, 1, false);
+}
+
+DictionaryResult dict_write_int8(DictionaryIterator *iter, const uint32_t key, const int8_t value) {
+  return dict_write_int(iter, key, &value, 1, true);
+}
+
+DictionaryResult dict_write_int16(DictionaryIterator *iter, const uint32_t key, const int16_t value) {
+  return dict_write_int(iter, key, &value, 2, true);
+}
+
+DictionaryResult dict_write_int32(DictionaryIterator *iter, const uint32_t key, const int32_t value) {
+  return dict_write_int(iter, key, &value, 4, true);
+}
+
+DictionaryResult dict_write_uint32(DictionaryIterator *iter, const uint32_t key, const uint32_t value) {
+  return dict_write_int(iter, key, &value, 4, false);
+}
+
+DictionaryResult dict_write_tuplet(DictionaryIterator *iter, const Tuplet *const tuplet) {
+  switch (tuplet->type) {
+    case TUPLE_BYTE_ARRAY:
+      return dict_write_data(iter, tuplet->key, tuplet->bytes.data, tuplet->bytes.length);
+    case TUPLE_CSTRING:
+      return write_tuple(iter, tuplet->key, TUPLE_CSTRING, tuplet->cstring.data, tuplet->cstring.length);
+    default:
+      return dict_write_int(iter, tuplet->key, &tuplet->integer.storage, tuplet->integer.width,
+                            tuplet->type == TUPLE_INT);
+  }
+}
+
+uint32_t dict_write_end(DictionaryIterator *iter) {
+  if (iter == NULL || iter->dictionary == NULL) return 0;
+  iter->end = iter->cursor;
+  return (uint8_t*)iter->cursor - (uint8_t*)iter->dictionary;
+}
+
+Tuple *dict_read_begin_from_buffer(DictionaryIterator *iter, const uint8_t *const buffer, const uint16_t size) {
+  if (iter == NULL || buffer == NULL || size < sizeof(Dictionary)) return NULL;
+  iter->dictionary = (Dictionary*)buffer;
+  iter->end = buffer + size;
+  return dict_read_first(iter);
+}
+
+Tuple *dict_read_first(DictionaryIterator *iter) {
+  iter->cursor = iter->dictionary->head;
+  if (iter->dictionary->count == 0 || (uint8_t*)iter->cursor + sizeof(Tuple) > (uint8_t*)iter->end) return NULL;
+  return iter->cursor;
+}
+
+Tuple *dict_read_next(DictionaryIterator *iter) {
+  if (iter->cursor == NULL) return NULL;
+  Tuple *next = next_tuple(iter->cursor);
+  if ((uint8_t*)next + sizeof(Tuple) > (uint8_t*)iter->end) {
+    iter->cursor = NULL;
+    return NULL;
+  }
+  iter->cursor = next;
+  return next;
+}
+
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key) {
+  Tuple *tuple = iter->dictionary->head;
+  for (uint8_t i = 0; i < iter->dictionary->count; i++) {
+    if ((uint8_t*)tuple + sizeof(Tuple) > (uint8_t*)iter->end) break;
+    if (tuple->key == key) return tuple;
+    tuple = next_tuple(tuple);
+  }
+  return NULL;
+}
+
+// --- AppMessage ---
+
+// Largest inbox/outbox the SDK allows on Basalt
+#define APP_MESSAGE_MAX_SIZE 8200
+
+static AppMessageInboxReceived s_inbox_received = NULL;
+static AppMessageInboxDropped s_inbox_dropped = NULL;
+static AppMessageOutboxSent s_outbox_sent = NULL;
+static AppMessageOutboxFailed s_outbox_failed = NULL;
+static HostOutboxHandler s_outbox_handler = NULL;
+static uint8_t *s_inbox = NULL;
+static uint32_t s_inbox_size = 0;
+static uint8_t *s_outbox = NULL;
+static uint32_t s_outbox_size = 0;
+static DictionaryIterator s_outbox_iter;
+static bool s_outbox_building = false;
+static bool s_outbox_sending = false;
+
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound) {
+  if (s_inbox != NULL) return APP_MSG_INVALID_STATE;
+  // (The buffers come from the app heap as on the watch)
+  s_inbox = host_malloc(size_inbound);
+  s_outbox = host_malloc(size_outbound);
+  if (s_inbox == NULL || s_outbox == NULL) return APP_MSG_OUT_OF_MEMORY;
+  s_inbox_size = size_inbound;
+  s_outbox_size = size_outbound;
+  return APP_MSG_OK;
+}
+
+uint32_t app_message_inbox_size_maximum(void) {
+  return APP_MESSAGE_MAX_SIZE;
+}
+
+uint32_t app_message_outbox_size_maximum(void) {
+  return APP_MESSAGE_MAX_SIZE;
+}
+
+AppMessageInboxReceived app_message_register_inbox_received(AppMessageInboxReceived received_callback) {
+  AppMessageInboxReceived previous = s_inbox_received;
+  s_inbox_received = received_callback;
+  return previous;
+}
+
+AppMessageInboxDropped app_message_register_inbox_dropped(AppMessageInboxDropped dropped_callback) {
+  AppMessageInboxDropped previous = s_inbox_dropped;
+  s_inbox_dropped = dropped_callback;
+  return previous;
+}
+
+AppMessageOutboxSent app_message_register_outbox_sent(AppMessageOutboxSent sent_callback) {
+  AppMessageOutboxSent previous = s_outbox_sent;
+  s_outbox_sent = sent_callback;
+  return previous;
+}
+
+AppMessageOutboxFailed app_message_register_outbox_failed(AppMessageOutboxFailed failed_callback) {
+  AppMessageOutboxFailed previous = s_outbox_failed;
+  s_outbox_failed = failed_callback;
+  return previous;
+}
+
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator) {
+  *iterator = NULL;
+  if (s_outbox == NULL) return APP_MSG_INVALID_STATE;
+  if (s_outbox_sending || s_outbox_building) return APP_MSG_BUSY;
+  dict_write_begin(&s_outbox_iter, s_outbox, s_outbox_size);
+  s_outbox_building = true;
+  *iterator = &s_outbox_iter;
+  return APP_MSG_OK;
+}
+
+AppMessageResult app_message_outbox_send(void) {
+  if (!s_outbox_building) return APP_MSG_INVALID_STATE;
+  s_outbox_building = false;
+  s_outbox_sending = true;
+  return APP_MSG_OK;
+}
+
+void host_set_outbox_handler(HostOutboxHandler handler) {
+  s_outbox_handler = handler;
+}
+
+// The phone receives and acknowledges a pending send
+static void complete_outbox_send(void) {
+  if (!s_outbox_sending) return;
+  s_outbox_sending = false;
+  DictionaryIterator iter;
+  dict_read_begin_from_buffer(&iter, s_outbox, (uint8_t*)s_outbox_iter.end - s_outbox);
+  if (s_outbox_sent != NULL) s_outbox_sent(&iter, NULL);
+  if (s_outbox_handler != NULL) s_outbox_handler(&iter);
+}
+
+void host_shutdown(void) {
+  // Windows the app left on the stack are unloaded
+  window_stack_pop_all(false);
+  while (s_timers != NULL) {
+    HostTimer *timer = s_timers;
+    s_timers = timer->next;
+    host_free(timer);
+  }
+  host_free(s_inbox);
+  host_free(s_outbox);
+  s_inbox = s_outbox = NULL;
+}
+
+void host_inbox_deliver(const uint8_t *buffer, uint16_t size) {
+  if (s_inbox == NULL) return;
+  if (size > s_inbox_size) {
+    if (s_inbox_dropped != NULL) s_inbox_dropped(APP_MSG_BUFFER_OVERFLOW, NULL);
+    return;
+  }
+  memcpy(s_inbox, buffer, size);
+  DictionaryIterator iter;
+  dict_read_begin_from_buffer(&iter, s_inbox, size);
+  if (s_inbox_received != NULL) s_inbox_received(&iter, NULL);
+}
+
+// --- Persistent storage ---
+
+#define PERSIST_MAX_KEYS 64
+
+typedef struct PersistEntry {
+  uint32_t key;
+  int size;
+  uint8_t data[PERSIST_DATA_MAX_LENGTH];
+} PersistEntry;
+
+static PersistEntry s_persist[PERSIST_MAX_KEYS];
+static int s_persist_count = 0;
+
+static PersistEntry *persist_find(uint32_t key) {
+  for (int i = 0; i < s_persist_count; i++)
+    if (s_persist[i].key == key) return &s_persist[i];
+  return NULL;
+}
+
+bool persist_exists(const uint32_t key) {
+  return persist_find(key) != NULL;
+}
+
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size) {
+  PersistEntry *entry = persist_find(key);
+  if (entry == NULL) return -1;
+  int size = ((size_t)entry->size < buffer_size) ? entry->size : (int)buffer_size;
+  memcpy(buffer, entry->data, size);
+  return size;
+}
+
+int persist_write_data(const uint32_t key, const void *data, const size_t size) {
+  PersistEntry *entry = persist_find(key);
+  if (entry == NULL) {
+    if (s_persist_count == PERSIST_MAX_KEYS) return -1;
+    entry = &s_persist[s_persist_count++];
+    entry->key = key;
+  }
+  entry->size = (size < PERSIST_DATA_MAX_LENGTH) ? (int)size : PERSIST_DATA_MAX_LENGTH;
+  memcpy(entry->data, data, entry->size);
+  return entry->size;
+}
+
+int persist_delete(const uint32_t key) {
+  PersistEntry *entry = persist_find(key);
+  if (entry == NULL) return -1;
+  *entry = s_persist[--s_persist_count];
+  return 0;
+}
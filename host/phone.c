@@ -0,0 +1,322 @@
+#include <pebble.h>
+#include "host.h"
+#include "phone.h"
+
+// JS App Message keys and function keys (must match package.json and comms.c)
+#define FUNCTION_KEY 0
+#define DEVICE_LIST 2
+#define DEVICE_ID 3
+#define DEVICE_LOCATION 4
+#define DEVICE_NAME 5
+#define DEVICE_TYPE 6
+#define DEVICE_STATUS 7
+#define STATUS_CHANGED 8
+#define DEVICE_SUMMARY 9
+#define SCENE_ID 10
+#define SCENE_DONE 11
+#define SCENE_TOTAL 12
+#define SCENE_FAILED 13
+#define DEVICE_REMOVED 14
+#define COMMAND_ID 15
+
+#define FK_LIST_DEVICES 1
+#define FK_GET_DEVICE_DETAILS 2
+#define FK_GET_DEVICE_STATUS 3
+#define FK_SET_DEVICE_STATUS 4
+#define FK_DEVICE_SUMMARY 5
+#define FK_SCENE 6
+#define FK_DEVICE_CHANGES 7
+
+// Largest message the phone sends (the JS splits summaries into chunks of this size)
+#define MESSAGE_SIZE 1024
+
+typedef struct {
+  int device_id;
+  DeviceType device_type;
+  DeviceStatus status;
+  time_t status_changed;
+  // Status a door or gate is travelling to (DSNone if it is not) and the time it gets there
+  DeviceStatus target;
+  uint32_t arrives;
+  char location[16];
+  char name[PHONE_MAX_NAME];
+} PhoneDevice;
+
+static PhoneDevice s_devices[PHONE_MAX_DEVICES];
+static int s_device_count = 0;
+static PhoneFleet s_fleet;
+static PhoneStats s_stats;
+static uint32_t s_random = 1;
+static uint8_t s_message[MESSAGE_SIZE];
+// The device list is sent in one message however long it is (as main.js does)
+static uint8_t s_list_message[PHONE_MAX_DEVICES * sizeof(int32_t) + 64];
+
+static const char *s_locations[] = {"Garage", "House", "Driveway", "Shed", "Holiday Home", "Barn", "Office", "Workshop"};
+// Words that names are padded out with
+static const char s_filler[] = " North Side Back Entrance Main Wing Upper Level East Yard";
+
+// Repeatable pseudo-random numbers, so that runs can be compared
+static int random_percent(void) {
+  s_random = s_random * 1103515245 + 12345;
+  return (s_random >> 16) % 100;
+}
+
+// Deliver a message to the app, counting it
+static void deliver(const uint8_t *buffer, uint16_t size) {
+  s_stats.messages++;
+  s_stats.bytes += size;
+  host_inbox_deliver(buffer, size);
+}
+
+static int find_device(int device_id) {
+  for (int i = 0; i < s_device_count; i++)
+    if (s_devices[i].device_id == device_id) return i;
+  return -1;
+}
+
+static void send_details(PhoneDevice *device) {
+  DictionaryIterator iter;
+  dict_write_begin(&iter, s_message, sizeof(s_message));
+  dict_write_int32(&iter, FUNCTION_KEY, FK_GET_DEVICE_DETAILS);
+  dict_write_int32(&iter, DEVICE_ID, device->device_id);
+  dict_write_cstring(&iter, DEVICE_LOCATION, device->location);
+  dict_write_cstring(&iter, DEVICE_NAME, device->name);
+  dict_write_uint8(&iter, DEVICE_TYPE, device->device_type);
+  deliver(s_message, dict_write_end(&iter));
+}
+
+static void send_status_set(int device_id, int command_id) {
+  DictionaryIterator iter;
+  dict_write_begin(&iter, s_message, sizeof(s_message));
+  dict_write_int32(&iter, FUNCTION_KEY, FK_SET_DEVICE_STATUS);
+  dict_write_int32(&iter, DEVICE_ID, device_id);
+  dict_write_int32(&iter, COMMAND_ID, command_id);
+  deliver(s_message, dict_write_end(&iter));
+}
+
+static void send_summary(void) {
+  for (int first = 0; first < s_device_count; ) {
+    int count = s_device_count - first;
+    uint16_t size;
+    // Shrink the chunk until it fits in a message
+    while ((size = phone_build_summary(s_message, sizeof(s_message), first, count)) == 0 && count > 1) count /= 2;
+    deliver(s_message, size);
+    first += count;
+  }
+}
+
+// Run a scene as main.js does when simulating (every device changes at once), reporting the
+// progress once done followed by a summary
+static void run_scene(SceneID scene_id) {
+  DeviceType device_type = (scene_id == SceneCloseAll) ? DTGarageDoor : DTLightSwitch;
+  DeviceStatus target = (scene_id == SceneCloseAll) ? DSClosed : DSOff;
+  int total = 0;
+  for (int i = 0; i < s_device_count; i++) {
+    if (s_devices[i].device_type == device_type && s_devices[i].status != target) {
+      phone_set_status(i, target);
+      total++;
+    }
+  }
+  DictionaryIterator iter;
+  dict_write_begin(&iter, s_message, sizeof(s_message));
+  dict_write_int32(&iter, FUNCTION_KEY, FK_SCENE);
+  dict_write_int32(&iter, SCENE_ID, scene_id);
+  dict_write_int32(&iter, SCENE_DONE, total);
+  dict_write_int32(&iter, SCENE_TOTAL, total);
+  dict_write_int32(&iter, SCENE_FAILED, 0);
+  deliver(s_message, dict_write_end(&iter));
+  send_summary();
+}
+
+// Start changing a device as the app asked (doors and gates travel to their new status when the
+// fleet has a travel time)
+static void start_change(PhoneDevice *device, DeviceStatus status) {
+  if (s_fleet.travel_ms > 0 && device->device_type != DTLightSwitch && device->status != status) {
+    device->status = (status == DSOnOpen) ? DSOpening : DSClosing;
+    time_ms(&device->status_changed, NULL);
+    device->target = status;
+    device->arrives = host_now() + s_fleet.travel_ms;
+  } else {
+    phone_set_status(device - s_devices, status);
+  }
+}
+
+// Bring a device's status up to date before it is sent: travel ends once it is due, and with the
+// fleet's volatility a device that is not travelling may have been changed by someone else
+static void update_status(PhoneDevice *device) {
+  if (device->target != DSNone) {
+    if ((int32_t)(host_now() - device->arrives) >= 0) phone_set_status(device - s_devices, device->target);
+  } else if (s_fleet.volatility > 0 && random_percent() < s_fleet.volatility) {
+    bool on_open = (device->status == DSOnOpen);
+    phone_set_status(device - s_devices, on_open ? ((device->device_type == DTLightSwitch) ? DSOff : DSClosed) : DSOnOpen);
+  }
+}
+
+// Answer a message sent by the app
+static void outbox_handler(DictionaryIterator *iter) {
+  Tuple *t_func = dict_find(iter, FUNCTION_KEY);
+  Tuple *t_device_id = dict_find(iter, DEVICE_ID);
+  int index = (t_device_id != NULL) ? find_device(t_device_id->value->int32) : -1;
+  if (t_func == NULL) return;
+  
+  switch (t_func->value->int32) {
+    case FK_LIST_DEVICES:
+      phone_connect();
+      break;
+    case FK_GET_DEVICE_DETAILS:
+      if (index >= 0) send_details(&s_devices[index]);
+      break;
+    case FK_GET_DEVICE_STATUS:
+      if (index >= 0) {
+        s_stats.status_fetches++;
+        update_status(&s_devices[index]);
+        deliver(s_message, phone_build_status(s_message, sizeof(s_message), s_devices[index].device_id,
+                                              s_devices[index].status, s_devices[index].status_changed));
+      }
+      break;
+    case FK_SET_DEVICE_STATUS:
+      if (index >= 0) {
+        Tuple *t_status = dict_find(iter, DEVICE_STATUS);
+        Tuple *t_command_id = dict_find(iter, COMMAND_ID);
+        if (t_status != NULL) start_change(&s_devices[index], t_status->value->int32);
+        send_status_set(s_devices[index].device_id, (t_command_id != NULL) ? t_command_id->value->int32 : 0);
+      }
+      break;
+    case FK_DEVICE_SUMMARY:
+      send_summary();
+      break;
+    case FK_SCENE: {
+      Tuple *t_scene_id = dict_find(iter, SCENE_ID);
+      if (t_scene_id != NULL) run_scene((SceneID)t_scene_id->value->int32);
+      break;
+    }
+  }
+}
+
+// Add a device to the fleet, with its last change spread over the past few days
+static void add_device(DeviceType device_type, int type_number) {
+  PhoneDevice *device = &s_devices[s_device_count];
+  int locations = (s_fleet.locations > 0 && s_fleet.locations < (int)ARRAY_LENGTH(s_locations)) ? 
+                  s_fleet.locations : (int)ARRAY_LENGTH(s_locations);
+  time_t now;
+  time_ms(&now, NULL);
+  device->device_id = 1000 + s_device_count;
+  device->device_type = device_type;
+  device->status = (device_type == DTLightSwitch) ? DSOff : DSClosed;
+  device->status_changed = now - s_device_count * 5400;
+  device->target = DSNone;
+  snprintf(device->location, sizeof(device->location), "%s", s_locations[s_device_count % locations]);
+  int length = snprintf(device->name, sizeof(device->name), "%s %d", 
+                        (device_type == DTLightSwitch) ? "Light" : (device_type == DTGate) ? "Gate" : "Door",
+                        type_number);
+  for (int i = 0; length < s_fleet.name_length && length < PHONE_MAX_NAME - 1; i++)
+    device->name[length++] = s_filler[i % (sizeof(s_filler) - 1)];
+  device->name[length] = '\0';
+  s_device_count++;
+}
+
+void phone_init(int device_count) {
+  s_fleet = (PhoneFleet){.locations = 4};
+  s_device_count = 0;
+  if (device_count > PHONE_MAX_DEVICES) device_count = PHONE_MAX_DEVICES;
+  for (int i = 0; i < device_count; i++) {
+    DeviceType device_type = (i % 5 == 4) ? DTGate : (i % 3 == 2) ? DTLightSwitch : DTGarageDoor;
+    add_device(device_type, i + 1);
+  }
+  host_set_outbox_handler(outbox_handler);
+}
+
+// The device types are interleaved in proportion, as a mixed fleet would be listed
+void phone_init_fleet(const PhoneFleet *fleet) {
+  DeviceType types[] = {DTGarageDoor, DTLightSwitch, DTGate};
+  int counts[] = {fleet->doors, fleet->lights, fleet->gates};
+  int added[] = {0, 0, 0};
+  int total = fleet->doors + fleet->lights + fleet->gates;
+  s_fleet = *fleet;
+  s_device_count = 0;
+  if (total > PHONE_MAX_DEVICES) total = PHONE_MAX_DEVICES;
+  for (int i = 0; i < total; i++) {
+    // Add the type furthest behind its share of the fleet
+    int next = -1;
+    for (int t = 0; t < 3; t++) {
+      if (added[t] < counts[t] && (next < 0 || added[t] * counts[next] < added[next] * counts[t])) next = t;
+    }
+    add_device(types[next], ++added[next]);
+  }
+  host_set_outbox_handler(outbox_handler);
+}
+
+PhoneStats phone_stats(void) {
+  return s_stats;
+}
+
+void phone_connect(void) {
+  int32_t ids[PHONE_MAX_DEVICES];
+  for (int i = 0; i < s_device_count; i++) ids[i] = s_devices[i].device_id;
+  DictionaryIterator iter;
+  dict_write_begin(&iter, s_list_message, sizeof(s_list_message));
+  dict_write_int32(&iter, FUNCTION_KEY, FK_LIST_DEVICES);
+  dict_write_data(&iter, DEVICE_LIST, (uint8_t*)ids, s_device_count * sizeof(int32_t));
+  deliver(s_list_message, dict_write_end(&iter));
+}
+
+int phone_device_id(int index) {
+  return s_devices[index].device_id;
+}
+
+void phone_set_status(int index, DeviceStatus status) {
+  s_devices[index].status = status;
+  s_devices[index].target = DSNone;
+  time_ms(&s_devices[index].status_changed, NULL);
+}
+
+uint16_t phone_build_status(uint8_t *buffer, uint16_t size, int device_id, DeviceStatus status, 
+                            time_t status_changed) {
+  DictionaryIterator iter;
+  dict_write_begin(&iter, buffer, size);
+  dict_write_int32(&iter, FUNCTION_KEY, FK_GET_DEVICE_STATUS);
+  dict_write_int32(&iter, DEVICE_ID, device_id);
+  dict_write_int8(&iter, DEVICE_STATUS, status);
+  dict_write_int32(&iter, STATUS_CHANGED, (int32_t)status_changed);
+  return dict_write_end(&iter);
+}
+
+// Summary records are laid out as in main.js (ID, type, status, status changed time, then location and name strings).
+// Returns 0 if the records do not fit
+uint16_t phone_build_summary(uint8_t *buffer, uint16_t size, int first, int count) {
+  uint8_t records[MESSAGE_SIZE];
+  uint16_t length = 0;
+  for (int i = first; i < first + count && i < s_device_count; i++) {
+    PhoneDevice *device = &s_devices[i];
+    const char *strings[] = {device->location, device->name};
+    if (length + 10 > sizeof(records)) return 0;
+    int32_t device_id = device->device_id;
+    uint32_t status_changed = device->status_changed;
+    memcpy(&records[length], &device_id, 4);
+    records[length + 4] = device->device_type;
+    records[length + 5] = (uint8_t)(int8_t)device->status;
+    memcpy(&records[length + 6], &status_changed, 4);
+    length += 10;
+    for (int s = 0; s < 2; s++) {
+      uint16_t string_size = strlen(strings[s]) + 1;
+      if (length + string_size > sizeof(records)) return 0;
+      memcpy(&records[length], strings[s], string_size);
+      length += string_size;
+    }
+  }
+  DictionaryIterator iter;
+  dict_write_begin(&iter, buffer, size);
+  dict_write_int32(&iter, FUNCTION_KEY, FK_DEVICE_SUMMARY);
+  if (dict_write_data(&iter, DEVICE_SUMMARY, records, length) != DICT_OK) return 0;
+  return dict_write_end(&iter);
+}
+
+uint16_t phone_build_changes(uint8_t *buffer, uint16_t size, const int32_t *added, int added_count,
+                             const int32_t *removed, int removed_count) {
+  DictionaryIterator iter;
+  dict_write_begin(&iter, buffer, size);
+  dict_write_int32(&iter, FUNCTION_KEY, FK_DEVICE_CHANGES);
+  if (added_count > 0) dict_write_data(&iter, DEVICE_LIST, (const uint8_t*)added, added_count * sizeof(int32_t));
+  if (removed_count > 0) dict_write_data(&iter, DEVICE_REMOVED, (const uint8_t*)removed, removed_count * sizeof(int32_t));
+  return dict_write_end(&iter);
+}
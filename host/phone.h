@@ -0,0 +1,47 @@
+#pragma once
+#include <pebble.h>
+#include "common.h"
+
+// Simulated phone JS, which answers the app's requests for a fleet of fake devices the same way
+// main.js answers them from the MyQ servers
+
+#define PHONE_MAX_DEVICES 512
+#define PHONE_MAX_NAME 48
+
+// Make-up of a generated fleet
+typedef struct PhoneFleet {
+  int doors;
+  int lights;
+  int gates;
+  int name_length;  // Names are padded out to this many characters (0 for short names)
+  int locations;    // Number of locations the devices are spread over
+  int travel_ms;    // Time doors and gates take to open or close (0 to change at once)
+  int volatility;   // Percent chance a device has been changed by someone else when its status is fetched
+} PhoneFleet;
+
+// Messages the phone has sent to the app
+typedef struct PhoneStats {
+  uint32_t messages;
+  uint32_t bytes;
+  uint32_t status_fetches;
+} PhoneStats;
+
+// Create the fleet and answer the app's messages (phone_init creates a mix of device_count devices
+// that change at once)
+void phone_init(int device_count);
+void phone_init_fleet(const PhoneFleet *fleet);
+PhoneStats phone_stats(void);
+
+// Send the device list (as the JS does once the app has started)
+void phone_connect(void);
+
+// Device IDs and statuses of the fleet
+int phone_device_id(int index);
+void phone_set_status(int index, DeviceStatus status);
+
+// Build the dictionaries the JS sends to the app, returning their size
+uint16_t phone_build_status(uint8_t *buffer, uint16_t size, int device_id, DeviceStatus status, 
+                            time_t status_changed);
+uint16_t phone_build_summary(uint8_t *buffer, uint16_t size, int first, int count);
+uint16_t phone_build_changes(uint8_t *buffer, uint16_t size, const int32_t *added, int added_count,
+                             const int32_t *removed, int removed_count);
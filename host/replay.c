@@ -0,0 +1,437 @@
+#include <pebble.h>
+#include <ctype.h>
+#include <time.h>
+#include "host.h"
+
+// Replays a recorded App Message trace into the watch app running on the host.
+// Traces are the 'MSG' lines logged by the watch app or the phone JS when built with MSG_RECORD
+// (other lines, such as the rest of a 'pebble logs' capture, are ignored):
+//   MSG <ms> > <payload>    watch to phone, compared with what the app sends
+//   MSG <ms> < <payload>    phone to watch, delivered to the app
+// Payloads are dictionaries in hex (from the watch, continued on 'MSG+ <hex>' lines) or flat JSON
+// objects (from the phone, with keys named as in the messageKeys of package.json).
+//
+// Messages are delivered at their original times, or with --max as soon as the app has sent every
+// message that preceded them in the trace. The replay fails if the app sends a message that is not in
+// the trace (messages in the trace that are not sent, such as those from button presses, are only
+// counted). The CPU time and allocations of the app are reported, so captured sessions double as
+// benchmarks.
+//
+// Usage: replay [--max] [--keys package.json] trace
+
+#define MAX_RECORDS 4096
+#define MAX_MESSAGE_SIZE 8200
+#define POOL_SIZE (1 << 20)
+#define MAX_KEYS 64
+
+// Virtual time given to the app between messages at maximum speed, and how long it can take to send
+// the messages expected before the next one is delivered
+#define MAX_SPEED_STEP_MS 10
+#define MAX_SPEED_TIMEOUT_MS 5000
+
+// Time allowed after the last message for the app to finish up
+#define SETTLE_MS 3000
+
+typedef struct {
+  uint32_t time;
+  char direction;
+  uint32_t offset;
+  uint16_t size;
+  int line;
+} Record;
+
+typedef struct {
+  char name[32];
+  uint32_t key;
+} MessageKey;
+
+static Record s_records[MAX_RECORDS];
+static int s_record_count = 0;
+static uint8_t s_pool[POOL_SIZE];
+static uint32_t s_pool_used = 0;
+static MessageKey s_keys[MAX_KEYS];
+static int s_key_count = 0;
+static bool s_max_speed = false;
+
+// Progress of comparing what the app sends with the '>' records. Messages in the trace can be
+// skipped (e.g. those sent because of button presses, which are not recorded)
+static int s_next_expected = 0;
+static int s_matched = 0;
+static int s_skipped = 0;
+static int s_unexpected = 0;
+
+// --- Parsing ---
+
+static void skip_space(const char **p) {
+  while (isspace((unsigned char)**p)) (*p)++;
+}
+
+static int hex_value(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// Append hex bytes to the pool, returning the number of bytes or -1 if it is not valid hex
+static int append_hex(const char *p) {
+  int count = 0;
+  skip_space(&p);
+  while (hex_value(p[0]) >= 0 && hex_value(p[1]) >= 0) {
+    if (s_pool_used >= POOL_SIZE) return -1;
+    s_pool[s_pool_used++] = (hex_value(p[0]) << 4) | hex_value(p[1]);
+    p += 2;
+    count++;
+  }
+  skip_space(&p);
+  return (*p == '\0') ? count : -1;
+}
+
+// Parse a JSON string (the opening quote has been read) into a null terminated UTF-8 buffer
+static bool parse_string(const char **p, char *out, int out_size) {
+  int length = 0;
+  while (**p != '"') {
+    if (**p == '\0' || length >= out_size - 4) return false;
+    char c = *(*p)++;
+    if (c == '\\') {
+      c = *(*p)++;
+      switch (c) {
+        case 'n': out[length++] = '\n'; break;
+        case 't': out[length++] = '\t'; break;
+        case 'r': out[length++] = '\r'; break;
+        case 'b': out[length++] = '\b'; break;
+        case 'f': out[length++] = '\f'; break;
+        case 'u': {
+          unsigned code = 0;
+          for (int i = 0; i < 4; i++) {
+            int digit = hex_value(*(*p)++);
+            if (digit < 0) return false;
+            code = (code << 4) | digit;
+          }
+          if (code < 0x80) {
+            out[length++] = code;
+          } else if (code < 0x800) {
+            out[length++] = 0xc0 | (code >> 6);
+            out[length++] = 0x80 | (code & 0x3f);
+          } else {
+            out[length++] = 0xe0 | (code >> 12);
+            out[length++] = 0x80 | ((code >> 6) & 0x3f);
+            out[length++] = 0x80 | (code & 0x3f);
+          }
+          break;
+        }
+        default: out[length++] = c; break;
+      }
+    } else {
+      out[length++] = c;
+    }
+  }
+  (*p)++;
+  out[length] = '\0';
+  return true;
+}
+
+static bool find_key(const char *name, uint32_t *key) {
+  for (int i = 0; i < s_key_count; i++) {
+    if (strcmp(s_keys[i].name, name) == 0) {
+      *key = s_keys[i].key;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Convert a flat JSON object to a dictionary in the pool (numbers become int32 as the phone sends them,
+// strings become cstrings and arrays of numbers become byte arrays), returning its size or -1
+static int append_json(const char *p) {
+  static uint8_t bytes[MAX_MESSAGE_SIZE];
+  static char text[MAX_MESSAGE_SIZE];
+  DictionaryIterator iter;
+  if (s_pool_used + MAX_MESSAGE_SIZE > POOL_SIZE) return -1;
+  dict_write_begin(&iter, &s_pool[s_pool_used], MAX_MESSAGE_SIZE);
+
+  skip_space(&p);
+  if (*p++ != '{') return -1;
+  skip_space(&p);
+  while (*p != '}') {
+    char name[32];
+    uint32_t key;
+    if (*p++ != '"' || !parse_string(&p, name, sizeof(name))) return -1;
+    if (!find_key(name, &key)) {
+      fprintf(stderr, "replay: unknown message key '%s'\n", name);
+      return -1;
+    }
+    skip_space(&p);
+    if (*p++ != ':') return -1;
+    skip_space(&p);
+    if (*p == '"') {
+      p++;
+      if (!parse_string(&p, text, sizeof(text))) return -1;
+      dict_write_cstring(&iter, key, text);
+    } else if (*p == '[') {
+      int length = 0;
+      p++;
+      skip_space(&p);
+      while (*p != ']') {
+        char *end;
+        long value = strtol(p, &end, 10);
+        if (end == p || length >= (int)sizeof(bytes)) return -1;
+        bytes[length++] = (uint8_t)value;
+        p = end;
+        skip_space(&p);
+        if (*p == ',') p++;
+        skip_space(&p);
+      }
+      p++;
+      dict_write_data(&iter, key, bytes, length);
+    } else if (strncmp(p, "true", 4) == 0 || strncmp(p, "false", 5) == 0) {
+      dict_write_int32(&iter, key, (*p == 't') ? 1 : 0);
+      p += (*p == 't') ? 4 : 5;
+    } else {
+      char *end;
+      long value = strtol(p, &end, 10);
+      if (end == p) return -1;
+      dict_write_int32(&iter, key, (int32_t)value);
+      p = end;
+    }
+    skip_space(&p);
+    if (*p == ',') p++;
+    skip_space(&p);
+  }
+  uint32_t size = dict_write_end(&iter);
+  s_pool_used += size;
+  return size;
+}
+
+// Read the message keys (name to key) from the messageKeys object in package.json
+static bool load_keys(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) return false;
+  static char json[65536];
+  size_t length = fread(json, 1, sizeof(json) - 1, file);
+  fclose(file);
+  json[length] = '\0';
+
+  const char *p = strstr(json, "\"messageKeys\"");
+  if (p == NULL || (p = strchr(p, '{')) == NULL) return false;
+  p++;
+  skip_space(&p);
+  while (*p == '"' && s_key_count < MAX_KEYS) {
+    p++;
+    if (!parse_string(&p, s_keys[s_key_count].name, sizeof(s_keys[s_key_count].name))) return false;
+    skip_space(&p);
+    if (*p++ != ':') return false;
+    s_keys[s_key_count++].key = strtoul(p, (char**)&p, 10);
+    skip_space(&p);
+    if (*p == ',') p++;
+    skip_space(&p);
+  }
+  return s_key_count > 0;
+}
+
+static bool load_trace(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) return false;
+  static char line[MAX_MESSAGE_SIZE * 3];
+  int line_number = 0;
+  while (fgets(line, sizeof(line), file) != NULL) {
+    line_number++;
+    line[strcspn(line, "\r\n")] = '\0';
+    const char *p = strstr(line, "MSG");
+    if (p == NULL) continue;
+
+    if (strncmp(p, "MSG+ ", 5) == 0) {
+      // Continuation of a long hex message
+      int length = (s_record_count > 0) ? append_hex(p + 5) : -1;
+      if (length < 0) goto bad_line;
+      s_records[s_record_count - 1].size += length;
+      continue;
+    }
+
+    unsigned time;
+    char direction;
+    int consumed;
+    if (sscanf(p, "MSG %u %c %n", &time, &direction, &consumed) != 2 || (direction != '<' && direction != '>'))
+      continue;
+    if (s_record_count == MAX_RECORDS) {
+      fprintf(stderr, "replay: too many messages, stopping at line %d\n", line_number);
+      break;
+    }
+    Record *record = &s_records[s_record_count];
+    record->time = time;
+    record->direction = direction;
+    record->offset = s_pool_used;
+    record->line = line_number;
+    int size = (p[consumed] == '{') ? append_json(p + consumed) : append_hex(p + consumed);
+    if (size < 0) goto bad_line;
+    record->size = size;
+    s_record_count++;
+    continue;
+
+  bad_line:
+    fprintf(stderr, "replay: bad message on line %d\n", line_number);
+    fclose(file);
+    return false;
+  }
+  fclose(file);
+  return true;
+}
+
+// --- Comparing sent messages ---
+
+// Integer value of a tuple (the phone sees integers, not their widths)
+static int64_t tuple_integer(const Tuple *tuple) {
+  switch (tuple->length) {
+    case 1: return (tuple->type == TUPLE_INT) ? tuple->value->int8 : tuple->value->uint8;
+    case 2: return (tuple->type == TUPLE_INT) ? tuple->value->int16 : tuple->value->uint16;
+    default: return (tuple->type == TUPLE_INT) ? tuple->value->int32 : tuple->value->uint32;
+  }
+}
+
+// Compare two dictionaries by their keys and values, ignoring tuple order and integer widths
+static bool dict_matches(DictionaryIterator *expected, DictionaryIterator *actual) {
+  int expected_count = 0;
+  for (Tuple *tuple = dict_read_first(expected); tuple != NULL; tuple = dict_read_next(expected)) {
+    expected_count++;
+    Tuple *other = dict_find(actual, tuple->key);
+    if (other == NULL) return false;
+    bool integer = (tuple->type == TUPLE_INT || tuple->type == TUPLE_UINT);
+    bool other_integer = (other->type == TUPLE_INT || other->type == TUPLE_UINT);
+    if (integer != other_integer) return false;
+    if (integer) {
+      if (tuple_integer(tuple) != tuple_integer(other)) return false;
+    } else if (tuple->length != other->length || memcmp(tuple->value->data, other->value->data, tuple->length) != 0) {
+      return false;
+    }
+  }
+  int actual_count = 0;
+  for (Tuple *tuple = dict_read_first(actual); tuple != NULL; tuple = dict_read_next(actual)) actual_count++;
+  return expected_count == actual_count;
+}
+
+static int next_record(int from, char direction) {
+  while (from < s_record_count && s_records[from].direction != direction) from++;
+  return from;
+}
+
+// Match a message sent by the app with the next message in the trace that it is the same as
+static void outbox_handler(DictionaryIterator *iter) {
+  int skipped = 0;
+  for (int i = next_record(s_next_expected, '>'); i < s_record_count; i = next_record(i + 1, '>')) {
+    DictionaryIterator expected;
+    dict_read_begin_from_buffer(&expected, &s_pool[s_records[i].offset], s_records[i].size);
+    if (dict_matches(&expected, iter)) {
+      s_matched++;
+      s_skipped += skipped;
+      s_next_expected = i + 1;
+      return;
+    }
+    skipped++;
+  }
+  s_unexpected++;
+  int line = (s_next_expected > 0) ? s_records[s_next_expected - 1].line : 0;
+  fprintf(stderr, "replay: app sent a message that is not in the trace (after line %d)\n", line);
+}
+
+// Number of '>' records before the given record that the app has not sent yet
+static int sends_outstanding(int index) {
+  int outstanding = 0;
+  for (int i = s_next_expected; i < index; i++)
+    if (s_records[i].direction == '>') outstanding++;
+  return outstanding;
+}
+
+// --- Replay ---
+
+static uint64_t s_cpu_ns = 0;
+static HostHeapStats s_heap_before;
+static int s_delivered = 0;
+static uint32_t s_virtual_start = 0;
+
+// Run the app for some virtual time, counting the CPU time it uses
+static void run_app(uint32_t ms) {
+  struct timespec started, now;
+  clock_gettime(CLOCK_MONOTONIC, &started);
+  host_run_timers(ms);
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  s_cpu_ns += (now.tv_sec - started.tv_sec) * 1000000000ull + now.tv_nsec - started.tv_nsec;
+}
+
+static void deliver(Record *record) {
+  struct timespec started, now;
+  clock_gettime(CLOCK_MONOTONIC, &started);
+  host_inbox_deliver(&s_pool[record->offset], record->size);
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  s_cpu_ns += (now.tv_sec - started.tv_sec) * 1000000000ull + now.tv_nsec - started.tv_nsec;
+  s_delivered++;
+}
+
+static void event_loop(void) {
+  host_set_outbox_handler(outbox_handler);
+  s_heap_before = host_heap_stats();
+  s_virtual_start = host_now();
+  uint32_t first_time = (s_record_count > 0) ? s_records[0].time : 0;
+
+  for (int i = next_record(0, '<'); i < s_record_count; i = next_record(i + 1, '<')) {
+    Record *record = &s_records[i];
+    if (s_max_speed) {
+      uint32_t waited = 0;
+      do {
+        run_app(MAX_SPEED_STEP_MS);
+        waited += MAX_SPEED_STEP_MS;
+      } while (sends_outstanding(i) > 0 && waited < MAX_SPEED_TIMEOUT_MS);
+    } else {
+      uint32_t due = s_virtual_start + (record->time - first_time);
+      if (due > host_now()) run_app(due - host_now());
+    }
+    deliver(record);
+  }
+  run_app(SETTLE_MS);
+
+  HostHeapStats heap = host_heap_stats();
+  for (int i = s_next_expected; i < s_record_count; i++)
+    if (s_records[i].direction == '>') s_skipped++;
+  int per_message = (s_delivered > 0) ? s_delivered : 1;
+  printf("replay: %d messages delivered over %u ms (%s)\n", s_delivered, host_now() - s_virtual_start,
+         s_max_speed ? "max speed" : "original speed");
+  printf("replay: %d sent messages matched the trace, %d did not, %d in the trace were not sent\n",
+         s_matched, s_unexpected, s_skipped);
+  printf("replay: app CPU %.1f us total, %.1f us per message delivered\n", s_cpu_ns / 1000.0,
+         s_cpu_ns / 1000.0 / per_message);
+  printf("replay: %.2f allocs (%.1f bytes) per message delivered, heap peak %d bytes\n",
+         (double)(heap.allocs - s_heap_before.allocs) / per_message,
+         (double)(heap.bytes_allocated - s_heap_before.bytes_allocated) / per_message, (int)heap.peak_used);
+}
+
+int homep_main(void);
+
+int main(int argc, char *argv[]) {
+  const char *keys_path = "../package.json";
+  const char *trace_path = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--max") == 0)
+      s_max_speed = true;
+    else if (strcmp(argv[i], "--keys") == 0 && i + 1 < argc)
+      keys_path = argv[++i];
+    else
+      trace_path = argv[i];
+  }
+  if (trace_path == NULL) {
+    fprintf(stderr, "Usage: replay [--max] [--keys package.json] trace\n");
+    return 2;
+  }
+  if (!load_keys(keys_path)) {
+    fprintf(stderr, "replay: could not read message keys from %s\n", keys_path);
+    return 2;
+  }
+  if (!load_trace(trace_path)) {
+    fprintf(stderr, "replay: could not read trace %s\n", trace_path);
+    return 2;
+  }
+
+  host_set_event_loop(event_loop);
+  homep_main();
+  host_shutdown();
+
+  return (s_unexpected == 0) ? 0 : 1;
+}
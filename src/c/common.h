@@ -2,6 +2,8 @@
 #include <pebble.h>
   
 //#define DEBUG
+//#define TRACE
+//#define MSG_RECORD
 #ifndef DEBUG
 #undef APP_LOG
 #define APP_LOG(...)
@@ -57,6 +59,14 @@ typedef enum DeviceStatus {
   DSVGDOOpen = 9
 } DeviceStatus;
 
+// Scenes that change many devices with one command (must match IDs in main.js)
+typedef enum SceneID {
+  SceneNone = 0,
+  SceneCloseAll = 1,
+  SceneLightsOff = 2
+} SceneID;
+#define SCENE_COUNT 2
+
 // Global variables
 extern int *g_device_id_list; // Will be allocated as an array when passed from phone
 extern int g_device_count;
@@ -1,5 +1,8 @@
 #include <pebble.h>
 #include "comms.h"
+#include "trace.h"
+#include "memstats.h"
+#include "msgrec.h"
 
 // Unit that contains all functionality for communicating with the phone JS
 
@@ -13,6 +16,13 @@
 #define DEVICE_TYPE 6
 #define DEVICE_STATUS 7
 #define STATUS_CHANGED 8
+#define DEVICE_SUMMARY 9
+#define SCENE_ID 10
+#define SCENE_DONE 11
+#define SCENE_TOTAL 12
+#define SCENE_FAILED 13
+#define DEVICE_REMOVED 14
+#define COMMAND_ID 15
 
 // List of message types (function keys - FK)
 #define FK_ERROR -1
@@ -20,6 +30,14 @@
 #define FK_GET_DEVICE_DETAILS 2
 #define FK_GET_DEVICE_STATUS 3
 #define FK_SET_DEVICE_STATUS 4
+#define FK_DEVICE_SUMMARY 5
+#define FK_SCENE 6
+#define FK_DEVICE_CHANGES 7
+
+// Preferred and smallest inbox size (the inbox is shrunk if the heap is short, but never below the
+// device summary messages the phone sends, of up to SUMMARY_CHUNK_SIZE (1000) bytes of summaries in main.js)
+#define INBOX_SIZE 2048
+#define INBOX_SIZE_MIN 1024
 
 // Callbacks for signalling inbound comms
 static CommsErrorCallback s_callback_error = NULL;
@@ -27,22 +45,50 @@ static DeviceListCallback s_callback_devicelist = NULL;
 static DeviceDetailsCallback s_callback_devicedetails = NULL;
 static DeviceStatusCallback s_callback_devicestatus = NULL;
 static DeviceStatusSetCallback s_callback_devicestatusset = NULL;
+static DeviceSummaryCallback s_callback_devicesummary = NULL;
+static DeviceSummaryDoneCallback s_callback_devicesummary_done = NULL;
+static SceneProgressCallback s_callback_sceneprogress = NULL;
+static DeviceChangesCallback s_callback_devicechanges = NULL;
 
 // Structure for passing single device details
+// (Location and name are interned in the string arena as soon as they are received)
+// (The location and name are interned when the details are handed over, as a device list received in
+//  between empties the string arena. strings holds the location then the name, each null terminated)
 typedef struct devicedetails_t {
   int device_id;
-  char location[30];
-  char name[30];
   DeviceType device_type;
+  char strings[];
 } devicedetails_t;
 
-// Structure for passing device status
+// Structure for passing device status (status_changed is a UTC time, 0 if unknown)
 typedef struct devicestatus_t {
   int device_id;
   int8_t status;
-  char status_changed[20];
+  time_t status_changed;
 } devicestatus_t;
 
+// Structure for passing confirmation that a status change command was sent (command_id is 0 if not given)
+typedef struct devicestatusset_t {
+  int device_id;
+  int command_id;
+} devicestatusset_t;
+
+// Structure for passing the progress of a scene
+typedef struct sceneprogress_t {
+  SceneID scene_id;
+  int done;
+  int total;
+  int failed;
+} sceneprogress_t;
+
+// Structure for passing the devices added to and removed from the device list
+// (The IDs of added devices are followed by the IDs of removed devices)
+typedef struct devicechanges_t {
+  int added_count;
+  int removed_count;
+  int ids[];
+} devicechanges_t;
+
 // Timer delayed callback for error messages from the JS or App Message errors
 // (Timers are used to call back to a listener after the App Message subsystem has cleared the buffer
 //  so that chained messaged do not cause busy errors)
@@ -62,8 +108,10 @@ void callback_devicelist_delayed(void *data) {
 void callback_devicedetails_delayed(void *data) {
   if (data != NULL) {
     devicedetails_t *details = data;
+    char *name = details->strings + strlen(details->strings) + 1;
     if (s_callback_devicedetails != NULL) 
-      s_callback_devicedetails(details->device_id, details->location, details->name, details->device_type);
+      s_callback_devicedetails(details->device_id, strarena_intern(details->strings), strarena_intern(name),
+                               details->device_type);
     free(data);
   }
 }
@@ -81,13 +129,70 @@ void callback_devicestatus_delayed(void *data) {
 // Timer delayed callback for receiving status set confirmation
 void callback_devicestatusset_delayed(void *data) {
   if (data != NULL) {
-    int *device_id = data;
+    devicestatusset_t *status_set = data;
     if (s_callback_devicestatusset != NULL)
-      s_callback_devicestatusset(*device_id);
+      s_callback_devicestatusset(status_set->device_id, status_set->command_id);
+    free(data);
+  }
+}
+
+// Timer delayed callback for receiving the progress of a scene
+void callback_sceneprogress_delayed(void *data) {
+  if (data != NULL) {
+    sceneprogress_t *progress = data;
+    if (s_callback_sceneprogress != NULL)
+      s_callback_sceneprogress(progress->scene_id, progress->done, progress->total, progress->failed);
     free(data);
   }
 }
 
+// Timer delayed callback for receiving changes to the device list
+void callback_devicechanges_delayed(void *data) {
+  if (data != NULL) {
+    devicechanges_t *changes = data;
+    if (s_callback_devicechanges != NULL)
+      s_callback_devicechanges(changes->ids, changes->added_count, &changes->ids[changes->added_count],
+                               changes->removed_count);
+    free(data);
+  }
+}
+
+// Timer delayed callback for signalling a chunk of device summaries has been received
+void callback_devicesummary_delayed(void *data) {
+  if (s_callback_devicesummary_done != NULL) s_callback_devicesummary_done();
+}
+
+// Gets a null terminated string from a byte array, returning NULL if it runs past the end
+static char* read_summary_string(uint8_t *data, uint16_t length, uint16_t *pos) {
+  char *str = (char*)&data[*pos];
+  while (*pos < length && data[*pos] != '\0') (*pos)++;
+  if (*pos >= length) return NULL;
+  (*pos)++;
+  return str;
+}
+
+// Parse a chunk of device summaries, which are sent as a byte array of records each made up of:
+// Device ID (int32), Device Type (uint8), Status (int8), Status Changed (uint32 UTC time), 
+// Location and Name (null terminated strings)
+static bool parse_device_summary(uint8_t *data, uint16_t length) {
+  uint16_t pos = 0;
+  while (pos + 10 <= length) {
+    int32_t device_id;
+    uint32_t status_changed;
+    memcpy(&device_id, &data[pos], sizeof(device_id));
+    DeviceType device_type = data[pos+4];
+    DeviceStatus status = (int8_t)data[pos+5];
+    memcpy(&status_changed, &data[pos+6], sizeof(status_changed));
+    pos += 10;
+    char *location = read_summary_string(data, length, &pos);
+    char *name = read_summary_string(data, length, &pos);
+    if (location == NULL || name == NULL) return false;
+    s_callback_devicesummary((int)device_id, strarena_intern(location), strarena_intern(name), device_type, 
+                             status, (time_t)status_changed);
+  }
+  return (pos == length);
+}
+
 // Show an error to the user using the error callback
 void show_error(char *error) {
   char *error_message = malloc(100);
@@ -98,6 +203,8 @@ void show_error(char *error) {
 
 // Received comms from JS
 static void inbox_received_callback(DictionaryIterator *iterator, void *context) {
+  MSG_RECORD_IN(iterator);
+  
   // Get the function key that defines the message type
   Tuple *t_func = dict_find(iterator, FUNCTION_KEY);
   
@@ -109,6 +216,11 @@ static void inbox_received_callback(DictionaryIterator *iterator, void *context)
   Tuple *t_type = NULL;
   Tuple *t_status = NULL;
   Tuple *t_status_changed = NULL;
+  Tuple *t_summary = NULL;
+  Tuple *t_scene_id = NULL;
+  Tuple *t_scene_done = NULL;
+  Tuple *t_scene_total = NULL;
+  Tuple *t_removed = NULL;
   char msg[50];
   
   if (t_func != NULL) {
@@ -128,10 +240,19 @@ static void inbox_received_callback(DictionaryIterator *iterator, void *context)
         // Find and parse device list, which is sent as a byte array of int
         t_id_list = dict_find(iterator, DEVICE_LIST);
         if (t_id_list != NULL) {
-          if (g_device_id_list != NULL) free(g_device_id_list);
+          if (g_device_id_list != NULL) {
+            free(g_device_id_list);
+            memstats_add(MSDevices, -(g_device_count * 4));
+          }
           g_device_id_list = malloc(t_id_list->length);
+          if (g_device_id_list == NULL) {
+            g_device_count = 0;
+            show_error("Not enough memory for device list");
+            break;
+          }
           memcpy(g_device_id_list, t_id_list->value->data, t_id_list->length);
           g_device_count = t_id_list->length / 4;
+          memstats_add(MSDevices, t_id_list->length);
           
           APP_LOG(APP_LOG_LEVEL_DEBUG, "Device Count: %d", g_device_count);
           for (int i = 0; i < g_device_count; i++)
@@ -154,13 +275,13 @@ static void inbox_received_callback(DictionaryIterator *iterator, void *context)
         if (t_device_id != NULL && t_location != NULL && t_name != NULL && t_type != NULL) {
           if (s_callback_devicedetails != NULL) {
             APP_LOG(APP_LOG_LEVEL_DEBUG, "Device ID Rx: %d", (int)t_device_id->value->int32);
-            devicedetails_t *details = malloc(sizeof(devicedetails_t));
+            size_t location_size = strlen(t_location->value->cstring) + 1;
+            size_t name_size = strlen(t_name->value->cstring) + 1;
+            devicedetails_t *details = malloc(sizeof(devicedetails_t) + location_size + name_size);
             details->device_id = (int)t_device_id->value->int32;
-            strncpy(details->location, t_location->value->cstring, sizeof(details->location));
-            details->location[sizeof(details->location)-1] = '\0';
-            strncpy(details->name, t_name->value->cstring, sizeof(details->name));
-            details->name[sizeof(details->name)-1] = '\0';
             details->device_type = t_type->value->uint8;
+            memcpy(details->strings, t_location->value->cstring, location_size);
+            memcpy(details->strings + location_size, t_name->value->cstring, name_size);
             
             // Callback to signal device details received after a short delay so that this proc can exit
             // before the app sends another message
@@ -181,12 +302,7 @@ static void inbox_received_callback(DictionaryIterator *iterator, void *context)
             status->device_id = (int)t_device_id->value->int32;
             status->status = t_status->value->int8;
             t_status_changed = dict_find(iterator, STATUS_CHANGED);
-            if (t_status_changed == NULL) {
-              strcpy(status->status_changed, "");
-            } else {
-              strncpy(status->status_changed, t_status_changed->value->cstring, sizeof(status->status_changed));
-              status->status_changed[sizeof(status->status_changed)-1] = '\0';
-            }
+            status->status_changed = (t_status_changed != NULL) ? (time_t)t_status_changed->value->uint32 : 0;
             
             // Callback to signal device status received after a short delay so that this proc can exit
             // before the app sends another message
@@ -201,15 +317,80 @@ static void inbox_received_callback(DictionaryIterator *iterator, void *context)
         // JS has indicated that the server received the new status
         t_device_id = dict_find(iterator, DEVICE_ID);
         if (t_device_id != NULL && s_callback_devicestatusset != NULL) {
-          int *device_id = malloc(sizeof(int));
-          *device_id = (int)t_device_id->value->int32;
+          devicestatusset_t *status_set = malloc(sizeof(devicestatusset_t));
+          status_set->device_id = (int)t_device_id->value->int32;
+          Tuple *t_command_id = dict_find(iterator, COMMAND_ID);
+          status_set->command_id = (t_command_id != NULL) ? (int)t_command_id->value->int32 : 0;
           
-          app_timer_register(100, callback_devicestatusset_delayed, device_id);
+          app_timer_register(100, callback_devicestatusset_delayed, status_set);
         } else {
           show_error("Set Devices Status comms missing parameter");
         }
         break;
       
+      case FK_DEVICE_SUMMARY:
+        // Received details and status of many devices at once
+        t_summary = dict_find(iterator, DEVICE_SUMMARY);
+        if (t_summary != NULL) {
+          if (s_callback_devicesummary != NULL) {
+            // Summaries are passed on straight away since they are only cached, but signalling that
+            // the chunk is complete is delayed so the listener can send messages
+            if (!parse_device_summary(t_summary->value->data, t_summary->length))
+              show_error("Device Summary comms badly formatted");
+            app_timer_register(100, callback_devicesummary_delayed, NULL);
+          }
+        } else {
+          show_error("Device Summary comms missing summary");
+        }
+        break;
+      
+      case FK_SCENE:
+        // Progress of a scene (sent as it starts, as devices finish and once it has finished)
+        t_scene_id = dict_find(iterator, SCENE_ID);
+        t_scene_done = dict_find(iterator, SCENE_DONE);
+        t_scene_total = dict_find(iterator, SCENE_TOTAL);
+        if (t_scene_id != NULL && t_scene_done != NULL && t_scene_total != NULL) {
+          if (s_callback_sceneprogress != NULL) {
+            sceneprogress_t *progress = malloc(sizeof(sceneprogress_t));
+            progress->scene_id = (SceneID)t_scene_id->value->int32;
+            progress->done = (int)t_scene_done->value->int32;
+            progress->total = (int)t_scene_total->value->int32;
+            Tuple *t_scene_failed = dict_find(iterator, SCENE_FAILED);
+            progress->failed = (t_scene_failed != NULL) ? (int)t_scene_failed->value->int32 : 0;
+            
+            app_timer_register(100, callback_sceneprogress_delayed, progress);
+          }
+        } else {
+          show_error("Scene comms missing parameter");
+        }
+        break;
+      
+      case FK_DEVICE_CHANGES:
+        // Devices added to or removed from the device list since it was sent (found by the phone checking
+        // the list in the background), each sent as a byte array of int (either may be missing)
+        t_id_list = dict_find(iterator, DEVICE_LIST);
+        t_removed = dict_find(iterator, DEVICE_REMOVED);
+        if (t_id_list != NULL || t_removed != NULL) {
+          if (s_callback_devicechanges != NULL) {
+            int added_count = (t_id_list != NULL) ? t_id_list->length / 4 : 0;
+            int removed_count = (t_removed != NULL) ? t_removed->length / 4 : 0;
+            devicechanges_t *changes = malloc(sizeof(devicechanges_t) + (added_count + removed_count) * sizeof(int));
+            if (changes == NULL) {
+              show_error("Not enough memory for device changes");
+              break;
+            }
+            changes->added_count = added_count;
+            changes->removed_count = removed_count;
+            if (added_count > 0) memcpy(changes->ids, t_id_list->value->data, added_count * 4);
+            if (removed_count > 0) memcpy(&changes->ids[added_count], t_removed->value->data, removed_count * 4);
+            
+            app_timer_register(100, callback_devicechanges_delayed, changes);
+          }
+        } else {
+          show_error("Device Changes comms missing device ID list");
+        }
+        break;
+      
       default:
         snprintf(msg, sizeof(msg), "Unknown comms message: %d", t_func->value->int16);
         show_error(msg);
@@ -246,9 +427,13 @@ void init_comms() {
   app_message_register_outbox_failed(outbox_failed_callback);
   app_message_register_outbox_sent(outbox_sent_callback);
 
-  // Open App Message
-  app_message_open((app_message_inbox_size_maximum() < 2048 ? app_message_inbox_size_maximum() : 2048), 
-                   APP_MESSAGE_OUTBOX_SIZE_MINIMUM);
+  // Open App Message (with a smaller inbox if there is not enough heap for the preferred size)
+  uint32_t inbox_size = (app_message_inbox_size_maximum() < INBOX_SIZE ? app_message_inbox_size_maximum() : INBOX_SIZE);
+  while (inbox_size > INBOX_SIZE_MIN && !memstats_can_alloc(inbox_size + APP_MESSAGE_OUTBOX_SIZE_MINIMUM))
+    inbox_size /= 2;
+  size_t heap_before = heap_bytes_used();
+  app_message_open(inbox_size, APP_MESSAGE_OUTBOX_SIZE_MINIMUM);
+  memstats_add(MSComms, heap_bytes_used() - heap_before);
 }
 
 void comms_register_errorhandler(CommsErrorCallback callback) {
@@ -271,6 +456,19 @@ void comms_register_devicestatusset(DeviceStatusSetCallback callback) {
   s_callback_devicestatusset = callback;
 }
 
+void comms_register_devicesummary(DeviceSummaryCallback callback, DeviceSummaryDoneCallback done_callback) {
+  s_callback_devicesummary = callback;
+  s_callback_devicesummary_done = done_callback;
+}
+
+void comms_register_sceneprogress(SceneProgressCallback callback) {
+  s_callback_sceneprogress = callback;
+}
+
+void comms_register_devicechanges(DeviceChangesCallback callback) {
+  s_callback_devicechanges = callback;
+}
+
 // Send request to list devices
 void device_list_fetch() {
   // Setup tuplets for function to phone
@@ -290,6 +488,7 @@ void device_list_fetch() {
   
   dict_write_tuplet(iter, &t_func);
   dict_write_end(iter);
+  MSG_RECORD_OUT(iter);
   
   // Send to phone
   app_message_outbox_send();
@@ -316,9 +515,11 @@ void device_details_fetch(int device_id) {
   dict_write_tuplet(iter, &t_func);
   dict_write_tuplet(iter, &t_device_ID);
   dict_write_end(iter);
+  MSG_RECORD_OUT(iter);
   
   // Send to phone
   app_message_outbox_send();
+  TRACE_EVENT(TEDetailsFetchSent, device_id);
 }
 
 // Send request to get device status
@@ -342,17 +543,20 @@ void device_status_fetch(int device_id) {
   dict_write_tuplet(iter, &t_func);
   dict_write_tuplet(iter, &t_device_ID);
   dict_write_end(iter);
+  MSG_RECORD_OUT(iter);
   
   // Send to phone
   app_message_outbox_send();
+  TRACE_EVENT(TEStatusFetchSent, device_id);
 }
 
 // Send request to set device status
-void device_status_set(int device_id, DeviceStatus status) {
+void device_status_set(int device_id, DeviceStatus status, int command_id) {
   // Setup tuplets for function to phone
   Tuplet t_func = TupletInteger(FUNCTION_KEY, FK_SET_DEVICE_STATUS);
   Tuplet t_device_ID = TupletInteger(DEVICE_ID, device_id);
   Tuplet t_status = TupletInteger(DEVICE_STATUS, status);
+  Tuplet t_command_id = TupletInteger(COMMAND_ID, command_id);
   
   // Put dictionary together
   DictionaryIterator *iter;
@@ -369,7 +573,61 @@ void device_status_set(int device_id, DeviceStatus status) {
   dict_write_tuplet(iter, &t_func);
   dict_write_tuplet(iter, &t_device_ID);
   dict_write_tuplet(iter, &t_status);
+  dict_write_tuplet(iter, &t_command_id);
+  dict_write_end(iter);
+  MSG_RECORD_OUT(iter);
+  
+  // Send to phone
+  app_message_outbox_send();
+}
+
+// Send request for a summary of all devices (details and status of every device in one transfer)
+void device_summary_fetch() {
+  // Setup tuplets for function to phone
+  Tuplet t_func = TupletInteger(FUNCTION_KEY, FK_DEVICE_SUMMARY);
+  
+  // Put dictionary together
+  DictionaryIterator *iter;
+  AppMessageResult result = app_message_outbox_begin(&iter);
+
+  if (iter == NULL) {
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "Send iter is NULL");
+    char msg[100];
+    snprintf(msg, sizeof(msg), "Device summary comms error: %d. Please restart app.", result);
+    show_error(msg);
+    return;
+  }
+  
+  dict_write_tuplet(iter, &t_func);
+  dict_write_end(iter);
+  MSG_RECORD_OUT(iter);
+  
+  // Send to phone
+  app_message_outbox_send();
+}
+
+// Send request to run a scene (the phone changes all the scene's devices at once and reports progress)
+void scene_run(SceneID scene_id) {
+  // Setup tuplets for function and scene to phone
+  Tuplet t_func = TupletInteger(FUNCTION_KEY, FK_SCENE);
+  Tuplet t_scene_id = TupletInteger(SCENE_ID, scene_id);
+  
+  // Put dictionary together
+  DictionaryIterator *iter;
+  AppMessageResult result = app_message_outbox_begin(&iter);
+
+  if (iter == NULL) {
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "Send iter is NULL");
+    char msg[100];
+    snprintf(msg, sizeof(msg), "Scene comms error: %d. Please restart app.", result);
+    show_error(msg);
+    return;
+  }
+  
+  dict_write_tuplet(iter, &t_func);
+  dict_write_tuplet(iter, &t_scene_id);
   dict_write_end(iter);
+  MSG_RECORD_OUT(iter);
   
   // Send to phone
   app_message_outbox_send();
@@ -1,12 +1,18 @@
 #pragma once
 #include <pebble.h>
 #include "common.h"
+#include "strarena.h"
 
 typedef void (*CommsErrorCallback)(char *error_message);
 typedef void (*DeviceListCallback)();
-typedef void (*DeviceDetailsCallback)(int device_id, char *location, char *name, DeviceType device_type);
-typedef void (*DeviceStatusCallback)(int device_id, DeviceStatus status, char *status_changed);
-typedef void (*DeviceStatusSetCallback)(int device_id);
+typedef void (*DeviceDetailsCallback)(int device_id, StrHandle location, StrHandle name, DeviceType device_type);
+typedef void (*DeviceStatusCallback)(int device_id, DeviceStatus status, time_t status_changed);
+typedef void (*DeviceStatusSetCallback)(int device_id, int command_id);
+typedef void (*DeviceSummaryCallback)(int device_id, StrHandle location, StrHandle name, DeviceType device_type, 
+                                      DeviceStatus status, time_t status_changed);
+typedef void (*DeviceSummaryDoneCallback)();
+typedef void (*SceneProgressCallback)(SceneID scene_id, int done, int total, int failed);
+typedef void (*DeviceChangesCallback)(int *added, int added_count, int *removed, int removed_count);
 
 void init_comms();
 void comms_register_errorhandler(CommsErrorCallback callback);
@@ -14,7 +20,12 @@ void comms_register_devicelist(DeviceListCallback callback);
 void comms_register_devicedetails(DeviceDetailsCallback callback);
 void comms_register_devicestatus(DeviceStatusCallback callback);
 void comms_register_devicestatusset(DeviceStatusSetCallback callback);
+void comms_register_devicesummary(DeviceSummaryCallback callback, DeviceSummaryDoneCallback done_callback);
+void comms_register_sceneprogress(SceneProgressCallback callback);
+void comms_register_devicechanges(DeviceChangesCallback callback);
 void device_list_fetch();
 void device_details_fetch(int device_id);
 void device_status_fetch(int device_id);
-void device_status_set(int device_id, DeviceStatus status);
\ No newline at end of file
+void device_status_set(int device_id, DeviceStatus status, int command_id);
+void device_summary_fetch();
+void scene_run(SceneID scene_id);
\ No newline at end of file
@@ -0,0 +1,75 @@
+#include "debugwin.h"
+#include "common.h"
+#include <pebble.h>
+
+// Scrollable text window used to show diagnostic information on the watch
+  
+static Window *s_window;
+static ScrollLayer *s_scroll_layer;
+static TextLayer *s_title_layer;
+static TextLayer *s_text_layer;
+
+static void initialise_ui(void) {
+  s_window = window_create();
+  Layer *root_layer = window_get_root_layer(s_window);
+  GRect bounds = layer_get_bounds(root_layer); 
+  window_set_background_color(s_window, GColorBlack); 
+  IF_2(window_set_fullscreen(s_window, true));
+  
+  // s_scroll_layer
+  s_scroll_layer = scroll_layer_create(bounds);
+  scroll_layer_set_click_config_onto_window(s_scroll_layer, s_window);
+  IF_3(scroll_layer_set_shadow_hidden(s_scroll_layer, true));
+  layer_add_child(root_layer, scroll_layer_get_layer(s_scroll_layer));
+  
+  // s_title_layer
+  s_title_layer = text_layer_create(GRect(PBL_IF_RECT_ELSE(2, 30), 0, bounds.size.w-PBL_IF_RECT_ELSE(4, 60), 20));
+  text_layer_set_font(s_title_layer, fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD));
+  text_layer_set_text_alignment(s_title_layer, GTextAlignmentCenter);
+  text_layer_set_text_color(s_title_layer, GColorWhite);
+  text_layer_set_background_color(s_title_layer, GColorClear);
+  scroll_layer_add_child(s_scroll_layer, text_layer_get_layer(s_title_layer));
+  
+  // s_text_layer (height set to the content size when the text is set)
+  s_text_layer = text_layer_create(GRect(PBL_IF_RECT_ELSE(2, 20), 22, bounds.size.w-PBL_IF_RECT_ELSE(4, 40), 2000));
+  text_layer_set_font(s_text_layer, fonts_get_system_font(FONT_KEY_GOTHIC_14));
+  text_layer_set_text_color(s_text_layer, GColorWhite);
+  text_layer_set_background_color(s_text_layer, GColorClear);
+  scroll_layer_add_child(s_scroll_layer, text_layer_get_layer(s_text_layer));
+}
+
+static void destroy_ui(void) {
+  window_destroy(s_window);
+  scroll_layer_destroy(s_scroll_layer);
+  text_layer_destroy(s_title_layer);
+  text_layer_destroy(s_text_layer);
+}
+
+static void handle_window_unload(Window* window) {
+  destroy_ui();
+  s_window = NULL;
+}
+
+// Show or update the window with the given title and text
+// (The text is not copied, so it must remain valid while the window is shown)
+void show_debugwin(const char *title, const char *text) {
+  if (s_window == NULL || !window_stack_contains_window(s_window)) {
+    initialise_ui();
+    window_set_window_handlers(s_window, (WindowHandlers) {
+      .unload = handle_window_unload,
+    });
+    window_stack_push(s_window, true);
+  }
+  
+  text_layer_set_text(s_title_layer, title);
+  text_layer_set_text(s_text_layer, text);
+  GSize text_size = text_layer_get_content_size(s_text_layer);
+  GRect frame = layer_get_frame(text_layer_get_layer(s_text_layer));
+  frame.size.h = text_size.h + 8;
+  layer_set_frame(text_layer_get_layer(s_text_layer), frame);
+  scroll_layer_set_content_size(s_scroll_layer, GSize(frame.size.w, frame.origin.y + frame.size.h + 10));
+}
+
+void hide_debugwin(void) {
+  if (s_window != NULL && window_stack_contains_window(s_window)) window_stack_remove(s_window, true);
+}
@@ -0,0 +1,5 @@
+#pragma once
+#include <pebble.h>
+
+void show_debugwin(const char *title, const char *text);
+void hide_debugwin(void);
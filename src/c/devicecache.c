@@ -0,0 +1,91 @@
+#include <pebble.h>
+#include "devicecache.h"
+#include "memstats.h"
+
+// Watch side cache of device details and statuses, indexed the same as the device ID list
+// (g_device_id_list) so that switching between devices can show local data straight away
+
+static DeviceCacheEntry *s_cache = NULL;
+static int s_cache_count = 0;
+
+// Allocate an empty cache for the given number of devices (freeing any previous cache)
+// If the cache would not fit in the heap budget, devices are not cached and are always fetched
+void devicecache_init(int device_count) {
+  devicecache_destroy();
+  if (device_count > 0 && memstats_can_alloc(device_count * sizeof(DeviceCacheEntry))) {
+    s_cache = malloc(device_count * sizeof(DeviceCacheEntry));
+    if (s_cache != NULL) {
+      s_cache_count = device_count;
+      memstats_add(MSDevices, s_cache_count * sizeof(DeviceCacheEntry));
+      for (int i = 0; i < s_cache_count; i++) {
+        memset(&s_cache[i], 0, sizeof(DeviceCacheEntry));
+        s_cache[i].device_type = DTUnknown;
+        s_cache[i].status = DSNone;
+      }
+    }
+  }
+}
+
+void devicecache_destroy() {
+  if (s_cache != NULL) {
+    free(s_cache);
+    s_cache = NULL;
+    memstats_add(MSDevices, -(int32_t)(s_cache_count * sizeof(DeviceCacheEntry)));
+  }
+  s_cache_count = 0;
+}
+
+// Re-index the cache after the device ID list has changed (from old_ids), keeping the entries of
+// devices that are still listed
+void devicecache_remap(const int *old_ids, int old_count) {
+  DeviceCacheEntry *old_cache = s_cache;
+  int old_cache_count = s_cache_count;
+  s_cache = NULL;
+  s_cache_count = 0;
+  devicecache_init(g_device_count);
+  for (int i = 0; i < s_cache_count; i++) {
+    for (int j = 0; j < old_cache_count && j < old_count; j++) {
+      if (old_ids[j] == g_device_id_list[i]) {
+        s_cache[i] = old_cache[j];
+        break;
+      }
+    }
+  }
+  if (old_cache != NULL) {
+    free(old_cache);
+    memstats_add(MSDevices, -(int32_t)(old_cache_count * sizeof(DeviceCacheEntry)));
+  }
+}
+
+// Gets the cache entry for a device list index (NULL if not cached)
+DeviceCacheEntry* devicecache_get(int index) {
+  if (s_cache == NULL || index < 0 || index >= s_cache_count) return NULL;
+  return &s_cache[index];
+}
+
+// Gets the device list index of a device ID (-1 if not found)
+int devicecache_find(int device_id) {
+  if (g_device_id_list == NULL) return -1;
+  for (int i = 0; i < g_device_count; i++) {
+    if (g_device_id_list[i] == device_id) return i;
+  }
+  return -1;
+}
+
+void devicecache_set_details(int device_id, StrHandle location, StrHandle name, DeviceType device_type) {
+  DeviceCacheEntry *entry = devicecache_get(devicecache_find(device_id));
+  if (entry != NULL) {
+    entry->location = location;
+    entry->name = name;
+    entry->device_type = device_type;
+    entry->has_details = true;
+  }
+}
+
+void devicecache_set_status(int device_id, DeviceStatus status, time_t status_changed) {
+  DeviceCacheEntry *entry = devicecache_get(devicecache_find(device_id));
+  if (entry != NULL) {
+    entry->status = status;
+    entry->status_changed = status_changed;
+  }
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <pebble.h>
+#include "common.h"
+#include "strarena.h"
+
+// Details and last known status of a device, cached so that cards can be shown without comms
+typedef struct {
+  bool has_details;
+  DeviceType device_type;
+  StrHandle location;
+  StrHandle name;
+  DeviceStatus status;
+  time_t status_changed;
+} DeviceCacheEntry;
+
+void devicecache_init(int device_count);
+void devicecache_destroy();
+void devicecache_remap(const int *old_ids, int old_count);
+DeviceCacheEntry* devicecache_get(int index);
+int devicecache_find(int device_id);
+void devicecache_set_details(int device_id, StrHandle location, StrHandle name, DeviceType device_type);
+void devicecache_set_status(int device_id, DeviceStatus status, time_t status_changed);
@@ -1,12 +1,32 @@
 #include <pebble.h>
 #include "devicecard_layer.h"
+#include "deviceicon.h"
+#include "trace.h"
 
 // Custom layer that draws a 'device card', storing and displaying all the details of a 
 // device including an icon.
 // This has been implemented as a layer so that it can be easily animated when switching between devices.
+
+// Interval between frames while a door/gate icon is moving
+#define ICON_ANIMATION_INTERVAL 125
+
+#ifdef TRACE
+// Flags for trace events waiting for the next draw of the card
+#define TRACE_PENDING_DETAILS 1
+#define TRACE_PENDING_STATUS 2
+#endif
   
-// Gets a textual description of a device status
+// Gets a millisecond clock reading for timing icon animations
+static uint32_t now_ms() {
+  time_t seconds;
+  uint16_t millis;
+  time_ms(&seconds, &millis);
+  return ((uint32_t)seconds * 1000) + millis;
+}
+
+// Gets a textual description of a device status (status_desc must hold at least 16 characters)
 static void get_status_desc(DeviceType device_type, DeviceStatus status, char *status_desc) {
+  status_desc[0] = '\0';
   switch (status) {
     case DSLoading:
       strcpy(status_desc, "Loading...");
@@ -53,47 +73,64 @@ static void get_status_desc(DeviceType device_type, DeviceStatus status, char *s
 }
 
 // Timer event that fires when the icon is being animated
+// The door/gate position is interpolated from the time since the operation started and the expected 
+// travel time, so the icon tracks the real door. Once the travel time has passed, the icon stays at
+// the target position until the real status is received.
 static void animate_icon(void *data) {
   if (data != NULL) {
     DeviceCardLayer *devicecard_layer = data;
     devicecard_layer->animation_timer = NULL;
-    switch (devicecard_layer->device_type) {
-      case DTGarageDoor:
-        // When opening or closing a garage door, increment or decrement an animation step
-        // and restart the timer before marking the layer dirty. The update proc will then
-        // draw the garage door according to the animation step
-        switch (devicecard_layer->status) {
-          case DSOpening:
-            devicecard_layer->animation_step = (devicecard_layer->animation_step + 5) % 6;
-            if (devicecard_layer->animation_step == 5)
-              devicecard_layer->animation_timer = app_timer_register(1000, animate_icon, data);
-            else
-              devicecard_layer->animation_timer = app_timer_register(500, animate_icon, data);
-            layer_mark_dirty(devicecard_layer->layer);
-            break;
-          case DSClosing:
-            devicecard_layer->animation_step = (devicecard_layer->animation_step + 1) % 6;
-            if (devicecard_layer->animation_step == 0)
-              devicecard_layer->animation_timer = app_timer_register(1000, animate_icon, data);
-            else
-              devicecard_layer->animation_timer = app_timer_register(500, animate_icon, data);
-            layer_mark_dirty(devicecard_layer->layer);
-            break;
-          default:
-            break;
-        }
-        break;
-      default:
-        break;
+    
+    uint32_t elapsed = now_ms() - devicecard_layer->animation_start;
+    uint32_t travel_time = deviceicon_travel_time(devicecard_layer->device_type);
+    uint8_t position = devicecard_layer->animation_target;
+    if (elapsed < travel_time) {
+      position = devicecard_layer->animation_from + 
+                 (((int32_t)devicecard_layer->animation_target - devicecard_layer->animation_from) * (int32_t)elapsed) / 
+                 (int32_t)travel_time;
+      devicecard_layer->animation_timer = app_timer_register(ICON_ANIMATION_INTERVAL, animate_icon, data);
+    }
+    
+    if (position != devicecard_layer->icon_position) {
+      devicecard_layer->icon_position = position;
+      layer_mark_dirty(devicecard_layer->icon_layer);
     }
   }
 }
 
-// Device card update proc that draws the whole layer
-static void devicecard_layer_update_proc(Layer *layer, GContext *ctx) {
+// Start moving the icon towards an open/closed position (unless already moving there)
+static void start_icon_animation(DeviceCardLayer *devicecard_layer, DeviceStatus previous_status, uint8_t target) {
+  if (devicecard_layer->animation_timer != NULL && devicecard_layer->animation_target == target) return;
+  
+  // If the door position was not known, assume it started from the other end
+  if (previous_status == DSLoading || previous_status == DSUpdating)
+    devicecard_layer->icon_position = (target == ICON_POSITION_OPEN) ? ICON_POSITION_CLOSED : ICON_POSITION_OPEN;
   
-  // Get reference to DeviceCardLayer and its properties
-  DeviceCardLayer *devicecard_layer = (DeviceCardLayer*)(layer_get_data(layer));
+  devicecard_layer->animation_from = devicecard_layer->icon_position;
+  devicecard_layer->animation_target = target;
+  devicecard_layer->animation_start = now_ms();
+  if (devicecard_layer->animation_timer == NULL)
+    devicecard_layer->animation_timer = app_timer_register(ICON_ANIMATION_INTERVAL, animate_icon, devicecard_layer);
+}
+
+// Stop any icon animation and show the icon at the given position
+static void stop_icon_animation(DeviceCardLayer *devicecard_layer, uint8_t position) {
+  if (devicecard_layer->animation_timer != NULL) {
+    app_timer_cancel(devicecard_layer->animation_timer);
+    devicecard_layer->animation_timer = NULL;
+  }
+  devicecard_layer->icon_position = position;
+}
+
+// Gets the DeviceCardLayer that a card region layer belongs to
+static DeviceCardLayer* get_region_card(Layer *layer) {
+  return *(DeviceCardLayer**)layer_get_data(layer);
+}
+
+// Device card update proc that draws the card border and background
+// (The text, status and icon are drawn by child region layers so that each can be invalidated on its own)
+static void devicecard_layer_update_proc(Layer *layer, GContext *ctx) {
+  TRACE_START(trace_start);
   
   // Draw Border and background
   GRect rect = layer_get_frame(layer);
@@ -107,105 +144,79 @@ static void devicecard_layer_update_proc(Layer *layer, GContext *ctx) {
   graphics_draw_round_rect(ctx, GRect(1, 1, rect.size.w-2, rect.size.h-2), 10);
 #endif
   
+  TRACE_DURATION(TECardUpdateProc, trace_start);
+}
+
+// Text region update proc that draws the device location and name
+static void text_region_update_proc(Layer *layer, GContext *ctx) {
+  TRACE_START(trace_start);
+  DeviceCardLayer *devicecard_layer = get_region_card(layer);
+  GRect rect = layer_get_bounds(layer);
+  
   graphics_context_set_text_color(ctx, GColorWhite);
   
   // Draw location text
-  graphics_draw_text(ctx, devicecard_layer->location, fonts_get_system_font(FONT_KEY_GOTHIC_14), 
-                     GRect(2, PBL_IF_RECT_ELSE(2, 8), rect.size.w-4, 16), GTextOverflowModeTrailingEllipsis, GTextAlignmentCenter, NULL);
+  graphics_draw_text(ctx, strarena_get(devicecard_layer->location), fonts_get_system_font(FONT_KEY_GOTHIC_14), 
+                     GRect(0, 0, rect.size.w, 16), GTextOverflowModeTrailingEllipsis, GTextAlignmentCenter, NULL);
   
   // Draw name text
-  graphics_draw_text(ctx, devicecard_layer->name, fonts_get_system_font(FONT_KEY_GOTHIC_14_BOLD), 
-                     GRect(2, PBL_IF_RECT_ELSE(14, 20), rect.size.w-4, 20), GTextOverflowModeTrailingEllipsis, GTextAlignmentCenter, NULL);
+  graphics_draw_text(ctx, strarena_get(devicecard_layer->name), fonts_get_system_font(FONT_KEY_GOTHIC_14_BOLD), 
+                     GRect(0, 12, rect.size.w, 20), GTextOverflowModeTrailingEllipsis, GTextAlignmentCenter, NULL);
+  
+#ifdef TRACE
+  // Record when real device details first reach the screen
+  if (devicecard_layer->trace_pending & TRACE_PENDING_DETAILS) 
+    trace_event(TEDetailsRendered, devicecard_layer->device_id);
+  devicecard_layer->trace_pending &= ~TRACE_PENDING_DETAILS;
+#endif
+  TRACE_DURATION(TECardTextProc, trace_start);
+}
+
+// Status region update proc that draws the status and when it last changed
+static void status_region_update_proc(Layer *layer, GContext *ctx) {
+  TRACE_START(trace_start);
+  DeviceCardLayer *devicecard_layer = get_region_card(layer);
+  GRect rect = layer_get_bounds(layer);
+  
+  graphics_context_set_text_color(ctx, GColorWhite);
   
   // Draw status text
-  char status_desc[30] = "";
-  get_status_desc(devicecard_layer->device_type, devicecard_layer->status, status_desc);
-  graphics_draw_text(ctx, status_desc, fonts_get_system_font(FONT_KEY_GOTHIC_14_BOLD), 
-                     GRect(2, rect.size.h-PBL_IF_RECT_ELSE(36, 42), rect.size.w-4, 20), GTextOverflowModeTrailingEllipsis, GTextAlignmentCenter, NULL);
+  graphics_draw_text(ctx, devicecard_layer->status_desc, fonts_get_system_font(FONT_KEY_GOTHIC_14_BOLD), 
+                     GRect(0, 0, rect.size.w, 20), GTextOverflowModeTrailingEllipsis, GTextAlignmentCenter, NULL);
   
   // Draw text indicating when the device status last changed
-  graphics_draw_text(ctx, devicecard_layer->status_changed, fonts_get_system_font(FONT_KEY_GOTHIC_14),
-                     GRect(2, rect.size.h-PBL_IF_RECT_ELSE(22, 30), rect.size.w-4, 16), GTextOverflowModeTrailingEllipsis, GTextAlignmentCenter, NULL);
+  graphics_draw_text(ctx, devicecard_layer->status_age, fonts_get_system_font(FONT_KEY_GOTHIC_14),
+                     GRect(0, PBL_IF_RECT_ELSE(14, 12), rect.size.w, 16), GTextOverflowModeTrailingEllipsis, GTextAlignmentCenter, NULL);
   
-  // Draw device icon showing On/Open or Off/Closed
-  GBitmap *device_icon = NULL;
+#ifdef TRACE
+  // Record when the real device status first reaches the screen
+  if (devicecard_layer->trace_pending & TRACE_PENDING_STATUS) 
+    trace_event(TEStatusRendered, devicecard_layer->device_id);
+  devicecard_layer->trace_pending &= ~TRACE_PENDING_STATUS;
+#endif
+  TRACE_DURATION(TECardStatusProc, trace_start);
+}
+
+// Icon region update proc that draws the device icon showing On/Open or Off/Closed
+static void icon_region_update_proc(Layer *layer, GContext *ctx) {
+  TRACE_START(trace_start);
+  DeviceCardLayer *devicecard_layer = get_region_card(layer);
   
-  switch (devicecard_layer->device_type) {
-    case DTGarageDoor:
-    
-      switch (devicecard_layer->status) {
-        case DSOnOpen:
-        case DSVGDOOpen:
-          device_icon = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_GARAGE_OPEN);
-          break;
-        case DSClosed:
-          device_icon = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_GARAGE_CLOSED);
-          break;
-        case DSOpening:
-        case DSClosing:
-          switch (devicecard_layer->animation_step) {
-            case 0:
-              device_icon = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_GARAGE_OPEN);
-              break;
-            case 1:
-              device_icon = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_GARAGE_STEP1);
-              break;
-            case 2:
-              device_icon = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_GARAGE_STEP2);
-              break;
-            case 3:
-              device_icon = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_GARAGE_STEP3);
-              break;
-            case 4:
-              device_icon = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_GARAGE_STEP4);
-              break;
-            default:
-              device_icon = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_GARAGE_CLOSED);
-              break;
-          }
-          break;
-        default:
-          // Do not draw an icon for other statuses
-          break;
-      }
-      
-      break;    
-    
-    case DTLightSwitch:
-      
-      switch (devicecard_layer->status) {
-        case DSOnOpen:
-        case DSTurningOff:
-          device_icon = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_LIGHTBULB_ON);
-          break;
-        case DSOff:
-        case DSTurningOn:
-          device_icon = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_LIGHTBULB_OFF);
-          break;
-        default:
-          // Do not draw an icon for other statuses
-          break;
-      }
-    
-      break;
-    
-    default:
-      // Only Garage Doors & Light Switches supported for now
-      break;
-  }
-      
-  if (device_icon != NULL) {
-    IF_COLOR(graphics_context_set_compositing_mode(ctx, GCompOpSet));
-    GRect icon_bounds = IF_32(gbitmap_get_bounds(device_icon), device_icon->bounds);
-    graphics_draw_bitmap_in_rect(ctx, device_icon, 
-                                 GRect((rect.size.w-icon_bounds.size.w)/2, 
-                                       (rect.size.h-icon_bounds.size.h)/2,
-                                       icon_bounds.size.w, icon_bounds.size.h));
-    gbitmap_destroy(device_icon);
-  }
+  deviceicon_draw(ctx, layer_get_bounds(layer), devicecard_layer->device_type, devicecard_layer->status, 
+                  devicecard_layer->icon_position);
   
+  TRACE_DURATION(TECardIconProc, trace_start);
 }
-  
+
+// Create a child layer for a region of the card
+static Layer* create_region(DeviceCardLayer *devicecard_layer, GRect frame, LayerUpdateProc update_proc) {
+  Layer *region = layer_create_with_data(frame, sizeof(DeviceCardLayer*));
+  *(DeviceCardLayer**)layer_get_data(region) = devicecard_layer;
+  layer_set_update_proc(region, update_proc);
+  layer_add_child(devicecard_layer->layer, region);
+  return region;
+}
+
 // Create DeviceCard layer
 DeviceCardLayer* devicecard_layer_create(GRect frame) {
   
@@ -216,19 +227,46 @@ DeviceCardLayer* devicecard_layer_create(GRect frame) {
   
   // Init properties
   devicecard_layer->layer = layer;
-  devicecard_layer->device_type = DTUnknown;
-  strcpy(devicecard_layer->location, "");
-  strcpy(devicecard_layer->name, "");
-  devicecard_layer->status = DSLoading;
-  strcpy(devicecard_layer->status_changed, "");
   devicecard_layer->animation_timer = NULL;
-  devicecard_layer->animation_step = 0;
   
   layer_set_update_proc(layer, devicecard_layer_update_proc);
   
+  // Create the independently redrawn regions of the card
+  devicecard_layer->text_layer = create_region(devicecard_layer, 
+                                               GRect(2, PBL_IF_RECT_ELSE(2, 8), frame.size.w-4, 34), 
+                                               text_region_update_proc);
+  devicecard_layer->icon_layer = create_region(devicecard_layer, deviceicon_get_frame(GRect(0, 0, frame.size.w, frame.size.h)),
+                                               icon_region_update_proc);
+  devicecard_layer->status_layer = create_region(devicecard_layer, 
+                                                 GRect(2, frame.size.h-PBL_IF_RECT_ELSE(36, 42), frame.size.w-4, PBL_IF_RECT_ELSE(34, 30)), 
+                                                 status_region_update_proc);
+  
+  devicecard_layer_reset(devicecard_layer);
+  
   return devicecard_layer;                    
 }
 
+// Reset DeviceCard layer properties in place so the card can be reused for another device
+void devicecard_layer_reset(DeviceCardLayer *devicecard_layer) {
+  if (devicecard_layer->animation_timer != NULL) {
+    app_timer_cancel(devicecard_layer->animation_timer);
+    devicecard_layer->animation_timer = NULL;
+  }
+  devicecard_layer->device_id = 0;
+  devicecard_layer->device_type = DTUnknown;
+  devicecard_layer->location = STR_EMPTY;
+  devicecard_layer->name = STR_EMPTY;
+  devicecard_layer->status = DSLoading;
+  get_status_desc(devicecard_layer->device_type, devicecard_layer->status, devicecard_layer->status_desc);
+  devicecard_layer->status_changed = 0;
+  strcpy(devicecard_layer->status_age, "");
+  devicecard_layer->icon_position = ICON_POSITION_CLOSED;
+#ifdef TRACE
+  devicecard_layer->trace_pending = 0;
+#endif
+  layer_mark_dirty(devicecard_layer->layer);
+}
+
 // Destroy DeviceCard layer
 void devicecard_layer_destroy(DeviceCardLayer *devicecard_layer) {
   if (devicecard_layer != NULL) {
@@ -237,8 +275,11 @@ void devicecard_layer_destroy(DeviceCardLayer *devicecard_layer) {
       devicecard_layer->animation_timer = NULL;
     }
     if (devicecard_layer->layer != NULL) {
+      layer_destroy(devicecard_layer->text_layer);
+      layer_destroy(devicecard_layer->status_layer);
+      layer_destroy(devicecard_layer->icon_layer);
+      // The card is stored in the base layer's data, so it can not be touched once that is destroyed
       layer_destroy(devicecard_layer->layer);
-      devicecard_layer->layer = NULL;
     }
   }
 }
@@ -248,62 +289,130 @@ Layer* devicecard_layer_get_layer(DeviceCardLayer *devicecard_layer){
   return devicecard_layer->layer;
 }
 
+// Sets the ID of the device the card shows (used to attribute trace events to the device)
+void devicecard_layer_set_device_id(DeviceCardLayer *devicecard_layer, int device_id) {
+  devicecard_layer->device_id = device_id;
+}
+
 // Sets device type
 void devicecard_layer_set_type(DeviceCardLayer *devicecard_layer, DeviceType device_type) {
+  if (devicecard_layer->device_type == device_type) return;
   devicecard_layer->device_type = device_type;
-  layer_mark_dirty(devicecard_layer->layer);
+  // The type changes the wording of the status (e.g. OPEN/ON) and the icon
+  get_status_desc(devicecard_layer->device_type, devicecard_layer->status, devicecard_layer->status_desc);
+  layer_mark_dirty(devicecard_layer->status_layer);
+  layer_mark_dirty(devicecard_layer->icon_layer);
 }
 
 // Sets device location
-void devicecard_layer_set_location(DeviceCardLayer *devicecard_layer, const char *location) {
-  strncpy(devicecard_layer->location, location, sizeof(devicecard_layer->location));
-  devicecard_layer->location[sizeof(devicecard_layer->location)-1] = '\0';
-  layer_mark_dirty(devicecard_layer->layer);
+// (Strings are interned, so the same handle means the same text)
+void devicecard_layer_set_location(DeviceCardLayer *devicecard_layer, StrHandle location) {
+  if (devicecard_layer->location == location) return;
+  devicecard_layer->location = location;
+  layer_mark_dirty(devicecard_layer->text_layer);
 }
 
 // Sets device name
-void devicecard_layer_set_name(DeviceCardLayer *devicecard_layer, const char *name) {
-  strncpy(devicecard_layer->name, name, sizeof(devicecard_layer->name));
-  devicecard_layer->name[sizeof(devicecard_layer->name)-1] = '\0';
-  layer_mark_dirty(devicecard_layer->layer);
+void devicecard_layer_set_name(DeviceCardLayer *devicecard_layer, StrHandle name) {
+  if (devicecard_layer->name == name) return;
+  devicecard_layer->name = name;
+#ifdef TRACE
+  if (name != STR_EMPTY) devicecard_layer->trace_pending |= TRACE_PENDING_DETAILS;
+#endif
+  layer_mark_dirty(devicecard_layer->text_layer);
 }
 
 // Sets device status
 void devicecard_layer_set_status(DeviceCardLayer *devicecard_layer, DeviceStatus status) {
+  if (devicecard_layer->status == status) return;
+  DeviceStatus previous_status = devicecard_layer->status;
   devicecard_layer->status = status;
+  get_status_desc(devicecard_layer->device_type, devicecard_layer->status, devicecard_layer->status_desc);
+#ifdef TRACE
+  if (status != DSLoading && status != DSUpdating) devicecard_layer->trace_pending |= TRACE_PENDING_STATUS;
+#endif
   
-  switch (devicecard_layer->device_type) {
-    case DTGarageDoor:
-      // Initialize icon animation if garage door is opening/closing
-      switch (status) {
-        case DSOpening:
-          devicecard_layer->animation_step = 5;
-          if (devicecard_layer->animation_timer == NULL)
-            devicecard_layer->animation_timer = app_timer_register(500, animate_icon, devicecard_layer);
-          else
-            app_timer_reschedule(devicecard_layer->animation_timer, 500);
-          break;
-        case DSClosing:
-          devicecard_layer->animation_step = 0;
-          if (devicecard_layer->animation_timer == NULL)
-            devicecard_layer->animation_timer = app_timer_register(500, animate_icon, devicecard_layer);
-          else
-            app_timer_reschedule(devicecard_layer->animation_timer, 500);
-          break;
-        default:
-          break;
-      }
-      break;
-    default:
-      break;
+  if (deviceicon_is_animated(devicecard_layer->device_type)) {
+    // Move the door/gate icon if opening/closing
+    switch (status) {
+      case DSOpening:
+        start_icon_animation(devicecard_layer, previous_status, ICON_POSITION_OPEN);
+        break;
+      case DSClosing:
+        start_icon_animation(devicecard_layer, previous_status, ICON_POSITION_CLOSED);
+        break;
+      case DSOnOpen:
+      case DSVGDOOpen:
+        stop_icon_animation(devicecard_layer, ICON_POSITION_OPEN);
+        break;
+      case DSClosed:
+        stop_icon_animation(devicecard_layer, ICON_POSITION_CLOSED);
+        break;
+      default:
+        stop_icon_animation(devicecard_layer, devicecard_layer->icon_position);
+        break;
+    }
   }
   
-  layer_mark_dirty(devicecard_layer->layer);
+  layer_mark_dirty(devicecard_layer->status_layer);
+  layer_mark_dirty(devicecard_layer->icon_layer);
 }
 
-// Sets device status changed description
-void devicecard_layer_set_status_changed(DeviceCardLayer *devicecard_layer, const char *status_changed) {
-  strncpy(devicecard_layer->status_changed, status_changed, sizeof(devicecard_layer->status_changed));
-  devicecard_layer->status_changed[sizeof(devicecard_layer->status_changed)-1] = '\0';
-  layer_mark_dirty(devicecard_layer->layer);
+// Start of the current day in local time (only worked out again once the day is over)
+static time_t s_today = 0;
+static time_t s_tomorrow = 0;
+
+// Describe how long a device has had its status from when it changed (0 if unknown): "since 3:42pm",
+// "since yesterday" and "for 3 days" match the phrases the phone used to send, while "just now" and
+// "for 5 mins" are new (the phone showed the time of the change instead)
+static void format_status_age(time_t status_changed, char *buffer, size_t size) {
+  if (status_changed == 0) {
+    buffer[0] = '\0';
+    return;
+  }
+  time_t now = time(NULL);
+  int mins = (now - status_changed) / 60;
+  if (mins < 1) {
+    snprintf(buffer, size, "just now");
+  } else if (mins < 60) {
+    snprintf(buffer, size, "for %d min%s", mins, (mins == 1) ? "" : "s");
+  } else {
+    if (now < s_today || now >= s_tomorrow) {
+      struct tm *now_tm = localtime(&now);
+      s_today = now - (now_tm->tm_hour * 3600 + now_tm->tm_min * 60 + now_tm->tm_sec);
+      s_tomorrow = s_today + 86400;
+    }
+    if (status_changed >= s_today) {
+      int hour = (status_changed - s_today) / 3600;
+      int min = ((status_changed - s_today) / 60) % 60;
+      if (clock_is_24h_style()) {
+        snprintf(buffer, size, "since %d:%02d", hour, min);
+      } else {
+        snprintf(buffer, size, "since %d:%02d%s", (hour % 12) ? (hour % 12) : 12, min, (hour >= 12) ? "pm" : "am");
+      }
+    } else {
+      int days = (s_today - status_changed) / 86400 + 1;
+      if (days == 1)
+        snprintf(buffer, size, "since yesterday");
+      else
+        snprintf(buffer, size, "for %d days", days);
+    }
+  }
+}
+
+// Sets when the device status changed (as a UTC time, 0 if unknown)
+void devicecard_layer_set_status_changed(DeviceCardLayer *devicecard_layer, time_t status_changed) {
+  if (devicecard_layer->status_changed == status_changed) return;
+  devicecard_layer->status_changed = status_changed;
+  devicecard_layer_refresh_age(devicecard_layer);
+}
+
+// Updates the description of how long the device has had its status (called every minute, only
+// redrawing when the description changes)
+void devicecard_layer_refresh_age(DeviceCardLayer *devicecard_layer) {
+  char status_age[sizeof(devicecard_layer->status_age)];
+  format_status_age(devicecard_layer->status_changed, status_age, sizeof(status_age));
+  if (strcmp(devicecard_layer->status_age, status_age) == 0) return;
+  strcpy(devicecard_layer->status_age, status_age);
+  layer_mark_dirty(devicecard_layer->status_layer);
 }
@@ -1,23 +1,39 @@
 #pragma once
 #include "common.h"
+#include "strarena.h"
   
 // Device Card layer structure, which stores all the properties necessary for showing the device details
 typedef struct {
   Layer *layer;
+  Layer *text_layer;
+  Layer *status_layer;
+  Layer *icon_layer;
+  int device_id;
   DeviceType device_type;
-  char location[30];
-  char name[30];
+  StrHandle location;
+  StrHandle name;
   DeviceStatus status;
-  char status_changed[20];
+  char status_desc[16];
+  time_t status_changed;
+  char status_age[20];
   AppTimer *animation_timer;
-  uint8_t animation_step;
+  uint32_t animation_start;
+  uint8_t animation_from;
+  uint8_t animation_target;
+  uint8_t icon_position;
+#ifdef TRACE
+  uint8_t trace_pending;
+#endif
 } DeviceCardLayer;
 
 DeviceCardLayer* devicecard_layer_create(GRect frame);
 void devicecard_layer_destroy(DeviceCardLayer *devicecard_layer);
+void devicecard_layer_reset(DeviceCardLayer *devicecard_layer);
+void devicecard_layer_set_device_id(DeviceCardLayer *devicecard_layer, int device_id);
 void devicecard_layer_set_type(DeviceCardLayer *devicecard_layer, DeviceType device_type);
-void devicecard_layer_set_location(DeviceCardLayer *devicecard_layer, const char *location);
-void devicecard_layer_set_name(DeviceCardLayer *devicecard_layer, const char *name);
+void devicecard_layer_set_location(DeviceCardLayer *devicecard_layer, StrHandle location);
+void devicecard_layer_set_name(DeviceCardLayer *devicecard_layer, StrHandle name);
 void devicecard_layer_set_status(DeviceCardLayer *devicecard_layer, DeviceStatus status);
-void devicecard_layer_set_status_changed(DeviceCardLayer *devicecard_layer, const char *status_changed);
+void devicecard_layer_set_status_changed(DeviceCardLayer *devicecard_layer, time_t status_changed);
+void devicecard_layer_refresh_age(DeviceCardLayer *devicecard_layer);
 Layer* devicecard_layer_get_layer(DeviceCardLayer *devicecard_layer);
\ No newline at end of file
@@ -0,0 +1,176 @@
+#include <pebble.h>
+#include "deviceicon.h"
+
+// Device icons drawn with vector graphics so they scale to the card size and door/gate
+// positions can be drawn at any point of travel (no bitmaps are loaded at all)
+
+// Expected time for a door or gate to fully open or close
+#define GARAGE_TRAVEL_MS 12000
+#define GATE_TRAVEL_MS 20000
+
+#define ICON_COLOR GColorWhite
+#define ICON_BACK_COLOR GColorBlack
+#define ICON_PANEL_COLOR IF_COLORBW(GColorLightGray, GColorWhite)
+#define ICON_LIGHT_COLOR IF_COLORBW(GColorYellow, GColorWhite)
+
+// Gets the frame of the icon within a card, keeping clear of the text above and below it
+GRect deviceicon_get_frame(GRect card_bounds) {
+  int16_t h = (card_bounds.size.h * 9) / 20;
+  int16_t w = (h * 5) / 4;
+  if (w > card_bounds.size.w - 10) w = card_bounds.size.w - 10;
+  return GRect((card_bounds.size.w - w) / 2, (card_bounds.size.h - h) / 2, w, h);
+}
+
+// Indicates if the device type has an icon that animates between open and closed
+bool deviceicon_is_animated(DeviceType device_type) {
+  return (device_type == DTGarageDoor || device_type == DTGate);
+}
+
+// Gets the expected travel time between open and closed for a device type
+uint32_t deviceicon_travel_time(DeviceType device_type) {
+  return (device_type == DTGate) ? GATE_TRAVEL_MS : GARAGE_TRAVEL_MS;
+}
+
+// Garage with a roller door that covers the opening down to the given position
+static void draw_garage(GContext *ctx, GRect frame, uint8_t position) {
+  int16_t left = frame.origin.x;
+  int16_t right = frame.origin.x + frame.size.w - 1;
+  int16_t top = frame.origin.y;
+  int16_t bottom = frame.origin.y + frame.size.h - 1;
+  int16_t eaves = top + (frame.size.h * 7) / 20;
+  
+  // Roof and walls
+  graphics_draw_line(ctx, GPoint(left, eaves), GPoint(left + frame.size.w / 2, top));
+  graphics_draw_line(ctx, GPoint(left + frame.size.w / 2, top), GPoint(right, eaves));
+  graphics_draw_line(ctx, GPoint(left + 2, eaves), GPoint(left + 2, bottom));
+  graphics_draw_line(ctx, GPoint(right - 2, eaves), GPoint(right - 2, bottom));
+  graphics_draw_line(ctx, GPoint(left, bottom), GPoint(right, bottom));
+  
+  // Door opening
+  GRect opening = GRect(left + frame.size.w / 5, top + (frame.size.h * 9) / 20, 
+                        (frame.size.w * 3) / 5, bottom - (top + (frame.size.h * 9) / 20));
+  graphics_draw_rect(ctx, opening);
+  
+  // Door panels lowered from the top of the opening
+  int16_t door_h = ((opening.size.h - 2) * position) / ICON_POSITION_CLOSED;
+  if (door_h > 0) {
+    graphics_context_set_fill_color(ctx, ICON_PANEL_COLOR);
+    graphics_fill_rect(ctx, GRect(opening.origin.x + 1, opening.origin.y + 1, opening.size.w - 2, door_h), 0, GCornerNone);
+    // Panel joins are drawn from the bottom edge of the door so they move with it
+    graphics_context_set_stroke_color(ctx, ICON_BACK_COLOR);
+    int16_t panel_h = (opening.size.h / 4 > 2) ? opening.size.h / 4 : 2;
+    for (int16_t y = opening.origin.y + door_h - panel_h; y > opening.origin.y; y -= panel_h)
+      graphics_draw_line(ctx, GPoint(opening.origin.x + 1, y), GPoint(opening.origin.x + opening.size.w - 2, y));
+    graphics_context_set_stroke_color(ctx, ICON_COLOR);
+  }
+}
+
+// Sliding gate between two posts, slid closed across the opening to the given position
+static void draw_gate(GContext *ctx, GRect frame, uint8_t position) {
+  int16_t left = frame.origin.x + 2;
+  int16_t right = frame.origin.x + frame.size.w - 3;
+  int16_t top = frame.origin.y + frame.size.h / 4;
+  int16_t bottom = frame.origin.y + frame.size.h - 1;
+  
+  // Posts and ground
+  graphics_fill_rect(ctx, GRect(left - 2, top - 4, 4, bottom - top + 5), 0, GCornerNone);
+  graphics_fill_rect(ctx, GRect(right - 1, top - 4, 4, bottom - top + 5), 0, GCornerNone);
+  graphics_draw_line(ctx, GPoint(frame.origin.x, bottom), GPoint(frame.origin.x + frame.size.w - 1, bottom));
+  
+  // Gate rails and bars
+  int16_t gate_w = ((right - left - 2) * position) / ICON_POSITION_CLOSED;
+  if (gate_w > 1) {
+    int16_t gate_left = left + 2;
+    int16_t gate_right = gate_left + gate_w;
+    graphics_draw_line(ctx, GPoint(gate_left, top + 2), GPoint(gate_right, top + 2));
+    graphics_draw_line(ctx, GPoint(gate_left, bottom - 3), GPoint(gate_right, bottom - 3));
+    int16_t bar_spacing = (right - left) / 6;
+    if (bar_spacing < 3) bar_spacing = 3;
+    // Bars are drawn from the leading edge so they move with the gate
+    for (int16_t x = gate_right; x >= gate_left; x -= bar_spacing)
+      graphics_draw_line(ctx, GPoint(x, top + 2), GPoint(x, bottom - 3));
+  }
+}
+
+// Light bulb, filled with rays when on and just an outline when off
+static void draw_lightbulb(GContext *ctx, GRect frame, bool on) {
+  int16_t size = (frame.size.w < frame.size.h) ? frame.size.w : frame.size.h;
+  int16_t radius = (size * 3) / 10;
+  GPoint centre = GPoint(frame.origin.x + frame.size.w / 2, frame.origin.y + (frame.size.h * 2) / 5);
+  int16_t base_w = radius;
+  int16_t base_top = centre.y + (radius * 4) / 5;
+  int16_t base_h = frame.origin.y + frame.size.h - 1 - base_top;
+  
+  if (on) {
+    graphics_context_set_fill_color(ctx, ICON_LIGHT_COLOR);
+    graphics_fill_circle(ctx, centre, radius);
+    graphics_context_set_stroke_color(ctx, ICON_LIGHT_COLOR);
+    // Rays around the top of the bulb
+    for (int i = -3; i <= 3; i++) {
+      int32_t angle = (TRIG_MAX_ANGLE * i) / 10;
+      int32_t sin = sin_lookup(angle);
+      int32_t cos = cos_lookup(angle);
+      graphics_draw_line(ctx, 
+                         GPoint(centre.x + (sin * (radius + 3)) / TRIG_MAX_RATIO, centre.y - (cos * (radius + 3)) / TRIG_MAX_RATIO),
+                         GPoint(centre.x + (sin * (radius + 3 + radius / 2)) / TRIG_MAX_RATIO, 
+                                centre.y - (cos * (radius + 3 + radius / 2)) / TRIG_MAX_RATIO));
+    }
+    graphics_context_set_stroke_color(ctx, ICON_COLOR);
+  } else {
+    graphics_draw_circle(ctx, centre, radius);
+  }
+  
+  // Screw base
+  graphics_context_set_fill_color(ctx, ICON_COLOR);
+  graphics_fill_rect(ctx, GRect(centre.x - base_w / 2, base_top, base_w, base_h), 2, GCornersBottom);
+  graphics_context_set_stroke_color(ctx, ICON_BACK_COLOR);
+  for (int16_t y = base_top + base_h / 3; y < base_top + base_h - 1; y += base_h / 3 > 1 ? base_h / 3 : 2)
+    graphics_draw_line(ctx, GPoint(centre.x - base_w / 2, y), GPoint(centre.x + base_w / 2 - 1, y));
+  graphics_context_set_stroke_color(ctx, ICON_COLOR);
+}
+
+// Draw device icon showing On/Open or Off/Closed (doors and gates at the given position)
+void deviceicon_draw(GContext *ctx, GRect frame, DeviceType device_type, DeviceStatus status, uint8_t position) {
+  graphics_context_set_stroke_color(ctx, ICON_COLOR);
+  graphics_context_set_fill_color(ctx, ICON_COLOR);
+  
+  switch (device_type) {
+    case DTGarageDoor:
+    case DTGate:
+      switch (status) {
+        case DSOnOpen:
+        case DSVGDOOpen:
+        case DSClosed:
+        case DSOpening:
+        case DSClosing:
+          if (device_type == DTGate)
+            draw_gate(ctx, frame, position);
+          else
+            draw_garage(ctx, frame, position);
+          break;
+        default:
+          // Do not draw an icon for other statuses
+          break;
+      }
+      break;
+    
+    case DTLightSwitch:
+      switch (status) {
+        case DSOnOpen:
+        case DSTurningOff:
+          draw_lightbulb(ctx, frame, true);
+          break;
+        case DSOff:
+        case DSTurningOn:
+          draw_lightbulb(ctx, frame, false);
+          break;
+        default:
+          // Do not draw an icon for other statuses
+          break;
+      }
+      break;
+    
+    default:
+      break;
+  }
+}
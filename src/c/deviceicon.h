@@ -0,0 +1,12 @@
+#pragma once
+#include <pebble.h>
+#include "common.h"
+
+// Door/gate positions used when drawing icons (0 is fully open, 100 is fully closed)
+#define ICON_POSITION_OPEN 0
+#define ICON_POSITION_CLOSED 100
+
+GRect deviceicon_get_frame(GRect card_bounds);
+bool deviceicon_is_animated(DeviceType device_type);
+uint32_t deviceicon_travel_time(DeviceType device_type);
+void deviceicon_draw(GContext *ctx, GRect frame, DeviceType device_type, DeviceStatus status, uint8_t position);
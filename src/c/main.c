@@ -2,9 +2,32 @@
 #include "mainwin.h"
 #include "comms.h"
 #include "msg.h"
+#include "devicecache.h"
+#include "overviewwin.h"
+#include "msgrec.h"
+#include "memstats.h"
+#include "usage.h"
 
 // Main application unit
 
+// Time the selected device must stay selected before its details/status are fetched
+// (Avoids busy comms errors and fetching for every device passed when scrolling quickly)
+#define SETTLE_MS 500
+
+// How long to wait before first checking the status of a device being changed, then between checks
+// (Doors and gates take a while to move. Must match the poll profiles of the device types in main.js)
+typedef struct {
+  uint32_t first_check_ms;
+  uint32_t check_ms;
+} PollProfile;
+
+static const PollProfile s_poll_profiles[] = {
+  [DTUnknown] = {10000, 2000},
+  [DTGarageDoor] = {10000, 2000},
+  [DTLightSwitch] = {3000, 2000},
+  [DTGate] = {15000, 2000}
+};
+
 // Global variables
 int *g_device_id_list; // Will be allocated as an array when passed from phone
 int g_device_count;
@@ -14,12 +37,14 @@ int g_device_selected;
 static DeviceStatus s_device_status_target = DSNone;
 static DeviceStatus s_device_status = 0;
 static DeviceType s_device_type = DTUnknown;
-static char s_status_changed[20] = "";
+static time_t s_status_changed = 0;
 static AppTimer *inactivity_timer = NULL;
 static AppTimer *status_change_timeout_timer = NULL;
 static AppTimer *status_change_check_timer = NULL;
 static AppTimer *details_fetch_delay_timer = NULL;
 static AppTimer *status_fetch_delay_timer = NULL;
+// ID of the latest status change command sent to the phone (0 before the first)
+static int s_command_id = 0;
 
 // Close the app after a period of inactivity (to prevent accidentally operating devices)
 void inactivity_timeout(void *data) {
@@ -57,6 +82,11 @@ void cancel_status_check() {
 void comms_error(char *error_message) {
   cancel_status_check();
   cancel_timeout();
+  // Stop expecting a status change (so pressing again sends the command again) and show the last known status
+  if (s_device_status_target != DSNone) {
+    s_device_status_target = DSNone;
+    show_device_status(s_device_status, s_status_changed);
+  }
   show_msg(error_message, false, 0);
   if (g_device_count == 0) {
     if (inactivity_timer != NULL) {
@@ -79,11 +109,72 @@ void device_list_fetched() {
   } else {
     if (!showing_mainwin()) show_mainwin();
     hide_msg();
+    // List the devices used most first, so the likeliest device is the first card (and fetched first)
+    usage_sort(g_device_id_list, g_device_count);
+    devicecache_init(g_device_count);
     g_device_selected = 0;
+    // Every device is replaced, so start a new string arena (nothing holds the old strings once the
+    // cache and cards are cleared) rather than keep the strings of devices no longer listed
+    clear_device_cards();
+    strarena_reset();
     device_details_fetch(g_device_id_list[g_device_selected]);
   }
 }
 
+// Indicates if a device ID is in a list of IDs
+static bool id_listed(int device_id, const int *ids, int count) {
+  for (int i = 0; i < count; i++) {
+    if (ids[i] == device_id) return true;
+  }
+  return false;
+}
+
+// Callback for when devices have been added to or removed from the device list
+// (Added devices go to the end of the list. The selected device stays selected unless it was removed
+//  and the cached details and status of every device still listed are kept)
+void device_list_changed(int *added, int added_count, int *removed, int removed_count) {
+  reset_inactivity_timer();
+  if (g_device_id_list == NULL) return;
+  
+  int *old_list = g_device_id_list;
+  int old_count = g_device_count;
+  int selected_id = (old_count > 0) ? old_list[g_device_selected] : 0;
+  int *new_list = malloc((old_count + added_count + 1) * sizeof(int));
+  if (new_list == NULL) {
+    comms_error("Not enough memory for device list");
+    return;
+  }
+  int count = 0;
+  for (int i = 0; i < old_count; i++) {
+    if (!id_listed(old_list[i], removed, removed_count)) new_list[count++] = old_list[i];
+  }
+  for (int i = 0; i < added_count; i++) {
+    if (!id_listed(added[i], new_list, count)) new_list[count++] = added[i];
+  }
+  g_device_id_list = new_list;
+  g_device_count = count;
+  memstats_add(MSDevices, (count - old_count) * 4);
+  devicecache_remap(old_list, old_count);
+  free(old_list);
+  
+  if (old_count == 0 || count == 0) {
+    // Treat as a new list, since there was no device to keep selected (or none to select)
+    cancel_status_check();
+    cancel_timeout();
+    s_device_status_target = DSNone;
+    device_list_fetched();
+    return;
+  }
+  overview_refresh();
+  int selected = devicecache_find(selected_id);
+  if (selected >= 0) {
+    g_device_selected = selected;
+    show_device_count();
+  } else {
+    select_device((g_device_selected < count) ? g_device_selected : count - 1);
+  }
+}
+
 // Timer event called to fetch device status after a brief delay to avoid busy comms error
 void status_fetch_delayed(void *data) {
   status_fetch_delay_timer = NULL;
@@ -91,16 +182,17 @@ void status_fetch_delayed(void *data) {
 }
 
 // Callback for when device details have been fetched
-void device_details_fetched(int device_id, char *location, char *name, DeviceType device_type) {
+void device_details_fetched(int device_id, StrHandle location, StrHandle name, DeviceType device_type) {
   APP_LOG(APP_LOG_LEVEL_DEBUG, "Details fetched - ID: %d, Location: %s, Name: %s, DeviceType: %d", 
-          device_id, location, name, device_type);
+          device_id, strarena_get(location), strarena_get(name), device_type);
   reset_inactivity_timer();
+  devicecache_set_details(device_id, location, name, device_type);
   
   if (g_device_id_list[g_device_selected] == device_id) {
     show_device_details(location, name, device_type);
     s_device_type = device_type;
     s_device_status = DSUpdating;
-    show_device_status(DSUpdating, "");
+    show_device_status(DSUpdating, 0);
     // Fetch device status after a brief delay to avoid busy comms error
     if (status_fetch_delay_timer == NULL)
       status_fetch_delay_timer = app_timer_register(100, status_fetch_delayed, NULL);
@@ -119,6 +211,12 @@ void status_change_timeout(void *data) {
   show_msg("Operation timed out", false, 5);
 }
 
+// Gets the poll profile of a device type (types the app does not know about are polled as doors)
+static const PollProfile *get_poll_profile(DeviceType device_type) {
+  if ((unsigned)device_type >= ARRAY_LENGTH(s_poll_profiles)) return &s_poll_profiles[DTUnknown];
+  return &s_poll_profiles[device_type];
+}
+
 // Timer event to update the device status periodically when it is changing
 void status_change_check(void *data) {
   reset_inactivity_timer();
@@ -127,10 +225,11 @@ void status_change_check(void *data) {
 }
 
 // Callbck for when the device status has been fetched
-void device_status_fetched(int device_id, DeviceStatus status, char *status_changed) {
+void device_status_fetched(int device_id, DeviceStatus status, time_t status_changed) {
   APP_LOG(APP_LOG_LEVEL_DEBUG, "Status fetched - ID: %d, Status: %d, Selected ID: %d", 
           device_id, status, g_device_id_list[g_device_selected]);
   reset_inactivity_timer();
+  devicecache_set_status(device_id, status, status_changed);
   
   if (g_device_id_list[g_device_selected] == device_id) {
     if (s_device_status_target != DSNone) {
@@ -138,17 +237,17 @@ void device_status_fetched(int device_id, DeviceStatus status, char *status_chan
       cancel_status_check();
       
       if (((status == DSVGDOOpen) ? DSOnOpen : status) != s_device_status_target) {
-        APP_LOG(APP_LOG_LEVEL_DEBUG, "Status still not reached target, checking again in 2 seconds...");
-        // Still not reached target status, so check again after 2 seconds
-        status_change_check_timer = app_timer_register(2000, status_change_check, NULL);
+        APP_LOG(APP_LOG_LEVEL_DEBUG, "Status still not reached target, checking again...");
+        // Still not reached target status, so check again shortly
+        status_change_check_timer = app_timer_register(get_poll_profile(s_device_type)->check_ms,
+                                                       status_change_check, NULL);
       } else {
         APP_LOG(APP_LOG_LEVEL_DEBUG, "Status has reached target");
         // Status changed, so stop checking
         cancel_timeout();
         s_device_status_target = DSNone;
         s_device_status = status;
-        strncpy(s_status_changed, status_changed, sizeof(s_status_changed));
-        s_status_changed[sizeof(s_status_changed)-1] = '\0';
+        s_status_changed = status_changed;
         show_device_status(status, status_changed);
         light_enable_interaction();
         vibes_short_pulse();
@@ -162,16 +261,22 @@ void device_status_fetched(int device_id, DeviceStatus status, char *status_chan
         s_device_status = status;
         light_enable_interaction();
       }
-      strncpy(s_status_changed, status_changed, sizeof(s_status_changed));
-      s_status_changed[sizeof(s_status_changed)-1] = '\0';
+      s_status_changed = status_changed;
       show_device_status(status, status_changed);
     }
   }
 }
 
-void device_details_fetch_delayed(void *data) {
+// Timer event for when the selected device has settled (the user has stopped scrolling)
+// Details are only fetched if they have not been cached yet, otherwise just the status is refreshed
+void device_selection_settled(void *data) {
   details_fetch_delay_timer = NULL;
-  device_details_fetch(g_device_id_list[g_device_selected]);
+  int device_id = g_device_id_list[g_device_selected];
+  DeviceCacheEntry *entry = devicecache_get(g_device_selected);
+  if (entry != NULL && entry->has_details)
+    device_status_fetch(device_id);
+  else
+    device_details_fetch(device_id);
 }
 
 // Callback for when user switches between devices
@@ -179,65 +284,99 @@ void device_switched() {
   reset_inactivity_timer();
   cancel_status_check();
   cancel_timeout();
+  s_device_status_target = DSNone;
   if (status_fetch_delay_timer != NULL) {
     app_timer_cancel(status_fetch_delay_timer);
     status_fetch_delay_timer = NULL;
   }
-  // Fetch device details after a brief delay to avoid busy comms error
+  
+  // Show any locally cached data while scrolling. The status can not be changed until
+  // the latest status has been fetched
+  DeviceCacheEntry *entry = devicecache_get(g_device_selected);
+  s_device_status = DSUpdating;
+  if (entry != NULL && entry->has_details) {
+    s_device_type = entry->device_type;
+    show_device_details(entry->location, entry->name, entry->device_type);
+    if (entry->status != DSNone)
+      show_device_status(entry->status, entry->status_changed);
+    else
+      show_device_status(DSUpdating, 0);
+  }
+  
+  // Fetch device details/status once the selection has settled
   if (details_fetch_delay_timer == NULL)
-    details_fetch_delay_timer = app_timer_register(500, device_details_fetch_delayed, NULL);
+    details_fetch_delay_timer = app_timer_register(SETTLE_MS, device_selection_settled, NULL);
   else
-    app_timer_reschedule(details_fetch_delay_timer, 500);
+    app_timer_reschedule(details_fetch_delay_timer, SETTLE_MS);
 }
 
 // Callback when user indicates status should be changed
+// Each change is a command with its own ID. Pressing again while a command is changing the device to the
+// same status is absorbed by that command, otherwise the new command supersedes it (and the phone ignores
+// repeats of a command and drops a queued command that has been superseded)
 void device_status_change() {
   reset_inactivity_timer();
+  DeviceStatus target;
+  DeviceStatus changing;
   switch (s_device_status) {
     case DSOnOpen:
       switch (s_device_type) {
         case DTLightSwitch:
-          s_device_status_target = DSOff;
-          show_device_status(DSTurningOff, "");
+          target = DSOff;
+          changing = DSTurningOff;
           break;
         default:
-          s_device_status_target = DSClosed;
-          show_device_status(DSClosing, "");
+          target = DSClosed;
+          changing = DSClosing;
           break;
       }
       break;
     case DSVGDOOpen:
     case DSOpening:
-      s_device_status_target = DSClosed;
-      show_device_status(DSClosing, "");
+      target = DSClosed;
+      changing = DSClosing;
       break;
     case DSOff:
-      s_device_status_target = DSOnOpen;
-      show_device_status(DSTurningOn, "");
+      target = DSOnOpen;
+      changing = DSTurningOn;
       break;
     case DSClosed:
     case DSClosing:
-      s_device_status_target = DSOnOpen;
-      show_device_status(DSOpening, "");
+      target = DSOnOpen;
+      changing = DSOpening;
       break;
     default:
       // Do nothing
       return;
       break;
   }
+  if (target == s_device_status_target) {
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "Command %d already changing status to %d", s_command_id, target);
+    return;
+  }
+  s_device_status_target = target;
+  show_device_status(changing, 0);
+  s_command_id = (s_command_id % 0x7fff) + 1;
+  cancel_status_check();
   // Send request to MyQ servers to change the status
-  device_status_set(g_device_id_list[g_device_selected], s_device_status_target);
-  status_change_timeout_timer = app_timer_register(60000, status_change_timeout, NULL);
+  device_status_set(g_device_id_list[g_device_selected], s_device_status_target, s_command_id);
+  usage_record(g_device_id_list[g_device_selected]);
+  if (status_change_timeout_timer == NULL)
+    status_change_timeout_timer = app_timer_register(60000, status_change_timeout, NULL);
+  else
+    app_timer_reschedule(status_change_timeout_timer, 60000);
 }
 
 // Callback for when the phone JS indicates the status change was sent to the MyQ server
-void device_status_change_sent(int device_id) {
+// (Confirmations of superseded commands are ignored. A command ID of 0 is from a phone without IDs)
+void device_status_change_sent(int device_id, int command_id) {
   reset_inactivity_timer();
-  if (s_device_status_target != DSNone && g_device_id_list[g_device_selected] == device_id) {
+  if (s_device_status_target != DSNone && g_device_id_list[g_device_selected] == device_id &&
+      (command_id == 0 || command_id == s_command_id)) {
     APP_LOG(APP_LOG_LEVEL_DEBUG, "Status change sent. Checking for status updates...");
     // Start checking for the status reaching the target 
-    // (For garage doors, wait 10 seconds before first check due to how long it take)
-    int first_check = (s_device_type == DTLightSwitch) ? 3000 : 10000;
+    // (For doors and gates, wait longer before the first check due to how long they take)
+    uint32_t first_check = get_poll_profile(s_device_type)->first_check_ms;
     if (status_change_check_timer != NULL)
       app_timer_reschedule(status_change_check_timer, first_check);
     else
@@ -245,8 +384,56 @@ void device_status_change_sent(int device_id) {
   }
 }
 
+// Callback for when the summary of a device has been received (details and status)
+void device_summary_received(int device_id, StrHandle location, StrHandle name, DeviceType device_type, 
+                             DeviceStatus status, time_t status_changed) {
+  devicecache_set_details(device_id, location, name, device_type);
+  devicecache_set_status(device_id, status, status_changed);
+}
+
+// Callback for when a chunk of device summaries has been received
+// (The phone also sends a summary when a scene finishes, so the selected card is refreshed from
+//  the cache unless its status is being changed or it is about to be fetched)
+void device_summary_fetched() {
+  reset_inactivity_timer();
+  overview_refresh();
+  DeviceCacheEntry *entry = devicecache_get(g_device_selected);
+  if (s_device_status_target == DSNone && details_fetch_delay_timer == NULL && status_fetch_delay_timer == NULL &&
+      entry != NULL && entry->has_details && entry->status != DSNone) {
+    s_device_status = entry->status;
+    show_device_status(entry->status, entry->status_changed);
+  }
+}
+
+// Callback when user asks for the overview of all devices
+void overview_requested() {
+  reset_inactivity_timer();
+  show_overviewwin();
+  // Fetch the latest details and status of all devices in one transfer
+  device_summary_fetch();
+}
+
+// Callback when user runs a scene on the overview
+void overview_scene_selected(SceneID scene_id) {
+  reset_inactivity_timer();
+  scene_run(scene_id);
+}
+
+// Callback for the progress of a running scene
+void scene_progress(SceneID scene_id, int done, int total, int failed) {
+  reset_inactivity_timer();
+  overview_set_scene_progress(scene_id, done, total, failed);
+}
+
+// Callback when user picks a device on the overview
+void overview_device_selected(int device_index) {
+  hide_overviewwin();
+  select_device(device_index);
+}
+
 void handle_init(void) {
   g_device_id_list = NULL;
+  usage_init();
   show_mainwin();
   show_msg("HomeP\n\nLogging In...", true, 0);
   comms_register_errorhandler(comms_error);
@@ -254,15 +441,25 @@ void handle_init(void) {
   comms_register_devicedetails(device_details_fetched);
   comms_register_devicestatus(device_status_fetched);
   comms_register_devicestatusset(device_status_change_sent);
+  comms_register_devicesummary(device_summary_received, device_summary_fetched);
+  comms_register_sceneprogress(scene_progress);
+  comms_register_devicechanges(device_list_changed);
   ui_register_deviceswitch(device_switched);
   ui_register_statuschange(device_status_change);
+  ui_register_overview(overview_requested);
+  overview_register_select(overview_device_selected);
+  overview_register_scene(overview_scene_selected);
   reset_inactivity_timer();
   // Initializing comms will trigger phone JS to fetch device list
   init_comms();
 }
 
 void handle_deinit(void) {
+  msgrec_dump();
+  usage_save();
   hide_mainwin();
+  devicecache_destroy();
+  strarena_destroy();
   if (g_device_id_list != NULL) {
     free(g_device_id_list);
     g_device_id_list = NULL;
@@ -1,5 +1,7 @@
 #include "mainwin.h"
 #include "devicecard_layer.h"
+#include "trace.h"
+#include "memstats.h"
 #include "common.h"
 #include <pebble.h>
 
@@ -9,6 +11,15 @@
 // Define spot size and spacing (spots indicate which device is being viewed)
 #define SPOT_RADIUS 3
 #define SPOT_SPACING 4
+// Beyond this many devices the spots are replaced by a scroll bar, which fits any device count
+#define MAX_SPOTS 13
+#define SPOT_PITCH ((SPOT_RADIUS*2)+SPOT_SPACING)
+
+// Holding up/down repeats the scroll, taking bigger steps the longer the button is held
+// (Cards scroll faster while repeating so each animation finishes before the next repeat)
+#define SCROLL_REPEAT_MS 200
+#define SCROLL_DURATION_MS 250
+#define SCROLL_FAST_DURATION_MS 120
 
 #ifdef PBL_ROUND
 #define DEV_LAYER_HEIGHT 148
@@ -26,6 +37,7 @@ static PropertyAnimation *s_pa_old;
 static PropertyAnimation *s_pa_new;
 static UIDeviceSwitchedCallback s_deviceswitched_callback;
 static UIStatusChangeCallback s_statuschange_callback;
+static UIOverviewCallback s_overview_callback;
 
 static Window *s_window;
 static GBitmap *s_res_image_action_up;
@@ -35,6 +47,19 @@ static ActionBarLayer *s_actionbar_main;
 static Layer *s_layer_spots;
 static DeviceCardLayer *s_devicecard_layer;
 
+// Spot positions are calculated when the device count changes rather than on every draw
+static GPoint s_spot_points[MAX_SPOTS];
+static int s_spots_layout_count = -1;
+#ifdef PBL_ROUND
+static GRect s_spots_circle;
+#endif
+
+// Heap measured for the cards and bitmaps (released from the memory stats when the window unloads)
+static int32_t s_cards_heap;
+static int32_t s_bitmaps_heap;
+
+static void cancel_card_animations();
+
 #ifndef PBL_SDK_2
 static StatusBarLayer *s_status_bar;
 #endif
@@ -59,9 +84,16 @@ static void initialise_ui(void) {
   s_rect_onscreen = GRect(dev_layer_left, dev_layer_top, DEV_LAYER_WIDTH, DEV_LAYER_HEIGHT);
   s_rect_below = GRect(dev_layer_left, bounds.size.h+2, DEV_LAYER_WIDTH, DEV_LAYER_HEIGHT);
   
-  // s_devicecard_layer
+  // s_devicecard_layer and s_devicecard_layer_old
+  // (Two persistent cards that swap roles when scrolling, so the spare card waits hidden offscreen)
+  size_t heap_before = heap_bytes_used();
   s_devicecard_layer = devicecard_layer_create(s_rect_onscreen);
   layer_add_child(root_layer, s_devicecard_layer->layer);
+  s_devicecard_layer_old = devicecard_layer_create(s_rect_below);
+  layer_set_hidden(s_devicecard_layer_old->layer, true);
+  layer_add_child(root_layer, s_devicecard_layer_old->layer);
+  s_cards_heap = heap_bytes_used() - heap_before;
+  memstats_add(MSCards, s_cards_heap);
   
   // s_layer_spots
   s_layer_spots = layer_create(PBL_IF_RECT_ELSE(GRect((dev_layer_left/2)-SPOT_RADIUS, dev_layer_top, 
@@ -74,9 +106,12 @@ static void initialise_ui(void) {
   layer_add_child(root_layer, status_bar_layer_get_layer(s_status_bar));
 #endif
   
+  heap_before = heap_bytes_used();
   s_res_image_action_up = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_ACTION_UP);
   s_res_image_action_set = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_ACTION_SET);
   s_res_image_action_down = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_ACTION_DOWN);
+  s_bitmaps_heap = heap_bytes_used() - heap_before;
+  memstats_add(MSBitmaps, s_bitmaps_heap);
   
   // s_actionbar_main
   s_actionbar_main = action_bar_layer_create();
@@ -93,6 +128,7 @@ static void initialise_ui(void) {
 }
 
 static void destroy_ui(void) {
+  cancel_card_animations();
   IF_3(status_bar_layer_destroy(s_status_bar));
   action_bar_layer_destroy(s_actionbar_main);
   devicecard_layer_destroy(s_devicecard_layer);
@@ -102,145 +138,212 @@ static void destroy_ui(void) {
   gbitmap_destroy(s_res_image_action_set);
   gbitmap_destroy(s_res_image_action_down);
   window_destroy(s_window);
+  memstats_add(MSCards, -s_cards_heap);
+  memstats_add(MSBitmaps, -s_bitmaps_heap);
 }
 
-// Draw the vertically stacked spots that indicate how many devices there are and which one is selected
-static void spots_draw(Layer *layer, GContext *ctx) {
+// Calculate the spot positions for the current device count
+static void layout_spots(Layer *layer) {
   GRect rect = layer_get_frame(layer);
-  graphics_context_set_stroke_color(ctx, GColorWhite);
-  graphics_context_set_fill_color(ctx, GColorWhite);
+  int spot_count = (g_device_count <= MAX_SPOTS) ? g_device_count : 0;
+  int spots_extent = (SPOT_PITCH * spot_count) - SPOT_SPACING;
   
-  for (int y = 0; y < g_device_count; y++) {
 #ifdef PBL_ROUND
-    GPoint spot = gpoint_from_polar(GRect(rect.origin.x+((rect.size.w-DEV_LAYER_WIDTH)/4),
-                                          rect.origin.y+((rect.size.h-DEV_LAYER_HEIGHT)/4),
-                                          rect.size.w-((rect.size.w-DEV_LAYER_WIDTH)/2),
-                                          rect.size.h-((rect.size.h-DEV_LAYER_HEIGHT)/2)), GOvalScaleModeFitCircle, 
-                                   DEG_TO_TRIGANGLE(270+
-                                      ((((SPOT_RADIUS*2)*g_device_count)+(SPOT_SPACING*(g_device_count-1)))/2) -
-                                       (y*((SPOT_RADIUS*2)+SPOT_SPACING)+3)));
+  s_spots_circle = GRect(rect.origin.x+((rect.size.w-DEV_LAYER_WIDTH)/4),
+                         rect.origin.y+((rect.size.h-DEV_LAYER_HEIGHT)/4),
+                         rect.size.w-((rect.size.w-DEV_LAYER_WIDTH)/2),
+                         rect.size.h-((rect.size.h-DEV_LAYER_HEIGHT)/2));
+#endif
+  for (int y = 0; y < spot_count; y++) {
+#ifdef PBL_ROUND
+    s_spot_points[y] = gpoint_from_polar(s_spots_circle, GOvalScaleModeFitCircle, 
+                                         DEG_TO_TRIGANGLE(270+(spots_extent/2)-(y*SPOT_PITCH+3)));
 #else
-    GPoint spot = GPoint((rect.size.w/2),
-                                     (rect.size.h/2)-((((SPOT_RADIUS*2)*g_device_count)+(SPOT_SPACING*(g_device_count-1)))/2) +
-                                     (y*((SPOT_RADIUS*2)+SPOT_SPACING)+3));
+    s_spot_points[y] = GPoint((rect.size.w/2), (rect.size.h/2)-(spots_extent/2)+(y*SPOT_PITCH+3));
 #endif
-    if (g_device_selected == y)
-      graphics_fill_circle(ctx, spot, SPOT_RADIUS);
-    else
-      graphics_draw_circle(ctx, spot, SPOT_RADIUS);
   }
+  s_spots_layout_count = g_device_count;
+}
+
+// Draw a scroll bar in place of the spots when there are too many devices for spots to fit
+static void scrollbar_draw(Layer *layer, GContext *ctx) {
+  int track_extent = (SPOT_PITCH * MAX_SPOTS) - SPOT_SPACING;
+  int thumb_extent = (SPOT_RADIUS*2)+4;
+  int thumb_offset = (g_device_selected * (track_extent - thumb_extent)) / (g_device_count - 1);
+  
+#ifdef PBL_ROUND
+  // Track and thumb follow the same arc as the spots
+  int track_top = 270+(track_extent/2);
+  graphics_draw_arc(ctx, s_spots_circle, GOvalScaleModeFitCircle, 
+                    DEG_TO_TRIGANGLE(track_top-track_extent), DEG_TO_TRIGANGLE(track_top));
+  graphics_fill_radial(ctx, grect_inset(s_spots_circle, GEdgeInsets(-SPOT_RADIUS)), GOvalScaleModeFitCircle, 
+                       (SPOT_RADIUS*2)+1, 
+                       DEG_TO_TRIGANGLE(track_top-thumb_offset-thumb_extent), DEG_TO_TRIGANGLE(track_top-thumb_offset));
+#else
+  GRect rect = layer_get_frame(layer);
+  int track_top = (rect.size.h/2)-(track_extent/2);
+  graphics_draw_line(ctx, GPoint(rect.size.w/2, track_top), GPoint(rect.size.w/2, track_top+track_extent));
+  graphics_fill_rect(ctx, GRect(0, track_top+thumb_offset, rect.size.w, thumb_extent), SPOT_RADIUS, GCornersAll);
+#endif
+}
+
+// Draw the vertically stacked spots that indicate how many devices there are and which one is selected
+static void spots_draw(Layer *layer, GContext *ctx) {
+  TRACE_START(trace_start);
+  if (s_spots_layout_count != g_device_count) layout_spots(layer);
+  
+  graphics_context_set_stroke_color(ctx, GColorWhite);
+  graphics_context_set_fill_color(ctx, GColorWhite);
+  
+  if (g_device_count > MAX_SPOTS) {
+    scrollbar_draw(layer, ctx);
+  } else {
+    for (int y = 0; y < g_device_count; y++) {
+      if (g_device_selected == y)
+        graphics_fill_circle(ctx, s_spot_points[y], SPOT_RADIUS);
+      else
+        graphics_draw_circle(ctx, s_spot_points[y], SPOT_RADIUS);
+    }
+  }
+  TRACE_DURATION(TESpotsUpdateProc, trace_start);
 }
 
 // Event for when the animation of the old device being switched away from finishes
 static void devicecard_anim_old_stopped(Animation *animation, bool finished, void *context) {
-  if (s_devicecard_layer_old != NULL) {
-    layer_remove_from_parent(s_devicecard_layer_old->layer);
-    devicecard_layer_destroy(s_devicecard_layer_old);
-    s_devicecard_layer_old = NULL;
+  DeviceCardLayer *devicecard_layer = context;
+  if (finished) {
+    // Park the card offscreen until it is needed for the next scroll
+    layer_set_hidden(devicecard_layer->layer, true);
+    devicecard_layer_reset(devicecard_layer);
   }
-  property_animation_destroy((PropertyAnimation*)animation);
+  if ((PropertyAnimation*)animation == s_pa_old) s_pa_old = NULL;
+  IF_2(property_animation_destroy((PropertyAnimation*)animation));
 }
 
 // Event for when the animation of the new device being switched in finishes
 static void devicecard_anim_new_stopped(Animation *animation, bool finished, void *context) {
-  property_animation_destroy((PropertyAnimation*)animation);
+  if ((PropertyAnimation*)animation == s_pa_new) s_pa_new = NULL;
+  IF_2(property_animation_destroy((PropertyAnimation*)animation));
+}
+
+// Stop any scroll animations that are still running, leaving the cards where they are
+// (Unscheduling calls the stopped handlers above with finished = false)
+static void cancel_card_animations() {
+  if (s_pa_old != NULL) animation_unschedule((Animation*)s_pa_old);
+  if (s_pa_new != NULL) animation_unschedule((Animation*)s_pa_new);
 }
 
 // Initialize the new device card properties
 static void init_card() {
-  
-  devicecard_layer_set_type(s_devicecard_layer, DTUnknown);
-  devicecard_layer_set_location(s_devicecard_layer, "");
-  devicecard_layer_set_name(s_devicecard_layer, "");
-  devicecard_layer_set_status(s_devicecard_layer, DSLoading);
-  devicecard_layer_set_status_changed(s_devicecard_layer, "");
-  
+  devicecard_layer_reset(s_devicecard_layer);
+  devicecard_layer_set_device_id(s_devicecard_layer, g_device_id_list[g_device_selected]);
 }
 
 // Animate device cards to make it look like they are being scrolled
 // up or down when switching devices
-static void animate_cards(GRect *from, GRect *to) {
+// (The old card moves from wherever it currently is, so a scroll that interrupts another
+//  scroll continues smoothly from the current position)
+static void animate_cards(GRect *from, GRect *to, uint32_t duration) {
   
-  s_pa_old = property_animation_create_layer_frame(s_devicecard_layer_old->layer, &s_rect_onscreen, to);
+  s_pa_old = property_animation_create_layer_frame(s_devicecard_layer_old->layer, NULL, to);
   s_pa_new = property_animation_create_layer_frame(s_devicecard_layer->layer, from, &s_rect_onscreen);
+  animation_set_duration((Animation*)s_pa_old, duration);
+  animation_set_duration((Animation*)s_pa_new, duration);
   
   animation_set_handlers(IF_32(property_animation_get_animation(s_pa_old), &(s_pa_old->animation)), 
                          (AnimationHandlers) {
     .stopped = devicecard_anim_old_stopped
-  }, NULL);
+  }, s_devicecard_layer_old);
   animation_set_handlers(IF_32(property_animation_get_animation(s_pa_new), &(s_pa_new->animation)), 
                          (AnimationHandlers) {
     .stopped = devicecard_anim_new_stopped
-  }, NULL);
+  }, s_devicecard_layer);
   
   animation_schedule((Animation*)s_pa_old);
   animation_schedule((Animation*)s_pa_new); 
   
 }
 
+// Swap the roles of the two cards and scroll the new card in from 'from' while the current 
+// card scrolls out to 'to'
+static void scroll_cards(GRect *from, GRect *to, uint32_t duration) {
+  cancel_card_animations();
+  
+  DeviceCardLayer *devicecard_layer = s_devicecard_layer_old;
+  s_devicecard_layer_old = s_devicecard_layer;
+  s_devicecard_layer = devicecard_layer;
+  
+  layer_set_frame(s_devicecard_layer->layer, *from);
+  layer_set_hidden(s_devicecard_layer->layer, false);
+  init_card();
+  TRACE_EVENT(TECardReset, g_device_selected);
+  
+  // Let main unit know device has been switched
+  if (s_deviceswitched_callback != NULL) s_deviceswitched_callback();
+  
+  animate_cards(from, to, duration);
+}
+
 static void select_click_handler(ClickRecognizerRef recognizer, void *context) {
+  TRACE_EVENT(TEClickSelect, g_device_selected);
   // Select button triggers device status change
   if (s_statuschange_callback != NULL) s_statuschange_callback();
 }
 
+static void select_long_click_handler(ClickRecognizerRef recognizer, void *context) {
+  // Long pressing select shows the overview of all devices
+  if (s_overview_callback != NULL) s_overview_callback();
+}
+
+// Gets how many devices to move for a click (accelerates when the button is held down)
+static int get_scroll_step(ClickRecognizerRef recognizer) {
+  if (!click_recognizer_is_repeating(recognizer)) return 1;
+  int repeats = click_number_of_clicks_counted(recognizer);
+  int step = (repeats > 15) ? 4 : (repeats > 8) ? 2 : 1;
+  // Never skip over so many devices that the scroll wraps past the selected device
+  return (step < g_device_count) ? step : 1;
+}
+
+// Gets the card animation duration for a click
+static uint32_t get_scroll_duration(ClickRecognizerRef recognizer) {
+  return click_recognizer_is_repeating(recognizer) ? SCROLL_FAST_DURATION_MS : SCROLL_DURATION_MS;
+}
+
 static void up_click_handler(ClickRecognizerRef recognizer, void *context) {
+  TRACE_EVENT(TEClickUp, g_device_selected);
   // Update selected device and scroll devices up 
-  g_device_selected = (g_device_selected+(g_device_count-1)) % g_device_count;
+  g_device_selected = (g_device_selected+(g_device_count-get_scroll_step(recognizer))) % g_device_count;
   layer_mark_dirty(s_layer_spots);
   
-  s_devicecard_layer_old = s_devicecard_layer;
-  s_devicecard_layer = devicecard_layer_create(s_rect_above);
-  Layer *root_layer = window_get_root_layer(s_window);
-  layer_add_child(root_layer, s_devicecard_layer->layer);
-  // Put statusbar and actionbar back on top
-#ifndef PBL_SDK_2
-  layer_remove_from_parent((Layer *)s_status_bar);
-  layer_add_child(root_layer, (Layer *)s_status_bar);
-#endif
-  layer_remove_from_parent((Layer *)s_actionbar_main);
-  layer_add_child(root_layer, (Layer *)s_actionbar_main);
-  init_card();
-  
-  // Let main unit know device has been switched
-  if (s_deviceswitched_callback != NULL) s_deviceswitched_callback();
-  
-  animate_cards(&s_rect_above, &s_rect_below);
+  scroll_cards(&s_rect_above, &s_rect_below, get_scroll_duration(recognizer));
 }
 
 static void down_click_handler(ClickRecognizerRef recognizer, void *context) {
+  TRACE_EVENT(TEClickDown, g_device_selected);
   // Update selected device and scroll devices down
-  g_device_selected = (g_device_selected+1) % g_device_count;
+  g_device_selected = (g_device_selected+get_scroll_step(recognizer)) % g_device_count;
   layer_mark_dirty(s_layer_spots);
   
-  s_devicecard_layer_old = s_devicecard_layer;
-  s_devicecard_layer = devicecard_layer_create(s_rect_below);
-  Layer *root_layer = window_get_root_layer(s_window);
-  layer_add_child(root_layer, s_devicecard_layer->layer);
-  // Put statusbar and actionbar back on top
-#ifndef PBL_SDK_2
-  layer_remove_from_parent((Layer *)s_status_bar);
-  layer_add_child(root_layer, (Layer *)s_status_bar);
-#endif
-  layer_remove_from_parent((Layer *)s_actionbar_main);
-  layer_add_child(root_layer, (Layer *)s_actionbar_main);
-  init_card();
-  
-  // Let main unit know device has been switched
-  if (s_deviceswitched_callback != NULL) s_deviceswitched_callback();
-  
-  animate_cards(&s_rect_below, &s_rect_above);
+  scroll_cards(&s_rect_below, &s_rect_above, get_scroll_duration(recognizer));
 }
 
 static void click_config_provider(void *context) {
   window_single_click_subscribe(BUTTON_ID_SELECT, select_click_handler);
-  window_single_click_subscribe(BUTTON_ID_UP, up_click_handler);
-  window_single_click_subscribe(BUTTON_ID_DOWN, down_click_handler);
+  window_single_repeating_click_subscribe(BUTTON_ID_UP, SCROLL_REPEAT_MS, up_click_handler);
+  window_single_repeating_click_subscribe(BUTTON_ID_DOWN, SCROLL_REPEAT_MS, down_click_handler);
+  window_long_click_subscribe(BUTTON_ID_SELECT, 0, select_long_click_handler, NULL);
 }
 
 static void handle_window_unload(Window* window) {
+  tick_timer_service_unsubscribe();
   destroy_ui();
 }
 
+// Keep the card's description of how long the device has had its status up to date
+static void handle_minute_tick(struct tm *tick_time, TimeUnits units_changed) {
+  devicecard_layer_refresh_age(s_devicecard_layer);
+}
+
 // Update device spots, which indicates the device count
 void show_device_count() {
   layer_mark_dirty(s_layer_spots);
@@ -254,15 +357,48 @@ void ui_register_statuschange(UIStatusChangeCallback callback) {
   s_statuschange_callback = callback;
 }
 
+void ui_register_overview(UIOverviewCallback callback) {
+  s_overview_callback = callback;
+}
+
+// Jump straight to a device without scrolling (e.g. when chosen from the overview)
+void select_device(int device_index) {
+  if (device_index < 0 || device_index >= g_device_count) return;
+  cancel_card_animations();
+  g_device_selected = device_index;
+  layer_mark_dirty(s_layer_spots);
+  
+  // Put the cards back where they would be at the end of a scroll
+  layer_set_frame(s_devicecard_layer->layer, s_rect_onscreen);
+  layer_set_hidden(s_devicecard_layer->layer, false);
+  layer_set_hidden(s_devicecard_layer_old->layer, true);
+  init_card();
+  
+  // Let main unit know device has been switched
+  if (s_deviceswitched_callback != NULL) s_deviceswitched_callback();
+}
+
+// Clear both cards for the selected device, dropping the strings they show (e.g. before a new
+// device list replaces the string arena)
+void clear_device_cards(void) {
+  cancel_card_animations();
+  layer_set_frame(s_devicecard_layer->layer, s_rect_onscreen);
+  layer_set_hidden(s_devicecard_layer->layer, false);
+  layer_set_hidden(s_devicecard_layer_old->layer, true);
+  devicecard_layer_reset(s_devicecard_layer_old);
+  init_card();
+  layer_mark_dirty(s_layer_spots);
+}
+
 // Update the current device card with the given details
-void show_device_details(const char *location, const char *name, const DeviceType device_type) {
+void show_device_details(StrHandle location, StrHandle name, const DeviceType device_type) {
   devicecard_layer_set_type(s_devicecard_layer, device_type);
   devicecard_layer_set_location(s_devicecard_layer, location);
   devicecard_layer_set_name(s_devicecard_layer, name);
 }
 
 // Update the current device card with the given status
-void show_device_status(const DeviceStatus status, const char *status_changed) {
+void show_device_status(const DeviceStatus status, time_t status_changed) {
   devicecard_layer_set_status(s_devicecard_layer, status);
   devicecard_layer_set_status_changed(s_devicecard_layer, status_changed);
 }
@@ -276,6 +412,7 @@ void show_mainwin(void) {
   
   layer_set_update_proc(s_layer_spots, spots_draw);
   action_bar_layer_set_click_config_provider(s_actionbar_main, click_config_provider);
+  tick_timer_service_subscribe(MINUTE_UNIT, handle_minute_tick);
   window_stack_push(s_window, true);
 }
 
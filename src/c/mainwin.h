@@ -1,15 +1,20 @@
 #include "common.h"
+#include "strarena.h"
 
 typedef void (*UIDeviceSwitchedCallback)();
 typedef void (*UIStatusChangeCallback)();
+typedef void (*UIOverviewCallback)();
 
 
 void ui_register_deviceswitch(UIDeviceSwitchedCallback callback);
 void ui_register_statuschange(UIStatusChangeCallback callback);
+void ui_register_overview(UIOverviewCallback callback);
 
 void show_device_count();
-void show_device_details(const char *location, const char *name, const DeviceType device_type);
-void show_device_status(const DeviceStatus status, const char *status_changed);
+void select_device(int device_index);
+void clear_device_cards(void);
+void show_device_details(StrHandle location, StrHandle name, const DeviceType device_type);
+void show_device_status(const DeviceStatus status, time_t status_changed);
 
 void show_mainwin(void);
 void hide_mainwin(void);
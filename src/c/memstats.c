@@ -0,0 +1,76 @@
+#include <pebble.h>
+#include "memstats.h"
+#include "debugwin.h"
+#include "common.h"
+
+// Heap usage accounting per subsystem, with the peak heap usage for the session.
+// Subsystems account for the heap they use by measuring heap_bytes_used() around allocations
+// (which also captures SDK overheads such as layer and bitmap headers).
+// Caches check memstats_can_alloc() before growing so that they degrade gracefully (e.g. stop
+// caching) while there is still enough heap left for windows and comms.
+
+// Heap that must be left free after any cache allocation
+#ifdef PBL_PLATFORM_APLITE
+#define HEAP_RESERVE 4096
+#else
+#define HEAP_RESERVE 8192
+#endif
+
+static int32_t s_subsystem_bytes[MSCount];
+static int s_subsystem_failures[MSCount];
+static size_t s_peak_used = 0;
+static size_t s_min_free = 0;
+static char s_text[200];
+
+static const char *s_subsystem_names[MSCount] = {
+  "Comms",
+  "Cards",
+  "Bitmaps",
+  "Devices"
+};
+
+// Record the current heap usage towards the session peak
+void memstats_sample(void) {
+  size_t used = heap_bytes_used();
+  size_t bytes_free = heap_bytes_free();
+  if (used > s_peak_used) s_peak_used = used;
+  if (s_min_free == 0 || bytes_free < s_min_free) s_min_free = bytes_free;
+}
+
+// Account heap bytes to (or with a negative value, release them from) a subsystem
+void memstats_add(MemSubsystem subsystem, int32_t bytes) {
+  s_subsystem_bytes[subsystem] += bytes;
+  memstats_sample();
+}
+
+// Count an allocation a subsystem could not make (e.g. a string that did not fit)
+void memstats_alloc_failed(MemSubsystem subsystem) {
+  s_subsystem_failures[subsystem]++;
+}
+
+int memstats_failures(MemSubsystem subsystem) {
+  return s_subsystem_failures[subsystem];
+}
+
+// Indicates if a cache allocation of the given size is within the heap budget
+bool memstats_can_alloc(size_t bytes) {
+  memstats_sample();
+  size_t bytes_free = heap_bytes_free();
+  return (bytes_free > bytes && bytes_free - bytes >= HEAP_RESERVE);
+}
+
+// Show heap usage on the watch (also written to the log)
+void memstats_show(void) {
+  memstats_sample();
+  int len = snprintf(s_text, sizeof(s_text), "Used: %d\nFree: %d\nPeak used: %d\nMin free: %d\n",
+                     (int)heap_bytes_used(), (int)heap_bytes_free(), (int)s_peak_used, (int)s_min_free);
+  for (int i = 0; i < MSCount && len < (int)sizeof(s_text); i++) {
+    if (s_subsystem_failures[i] > 0)
+      len += snprintf(s_text + len, sizeof(s_text) - len, "%s: %d (%d failed)\n", s_subsystem_names[i],
+                      (int)s_subsystem_bytes[i], s_subsystem_failures[i]);
+    else
+      len += snprintf(s_text + len, sizeof(s_text) - len, "%s: %d\n", s_subsystem_names[i], (int)s_subsystem_bytes[i]);
+  }
+  app_log(APP_LOG_LEVEL_INFO, "memstats", 0, "%s", s_text);
+  show_debugwin("Memory", s_text);
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <pebble.h>
+
+// Subsystems that heap usage is accounted to
+typedef enum MemSubsystem {
+  MSComms = 0,
+  MSCards,
+  MSBitmaps,
+  MSDevices,
+  MSCount
+} MemSubsystem;
+
+void memstats_add(MemSubsystem subsystem, int32_t bytes);
+void memstats_alloc_failed(MemSubsystem subsystem);
+int memstats_failures(MemSubsystem subsystem);
+void memstats_sample(void);
+bool memstats_can_alloc(size_t bytes);
+void memstats_show(void);
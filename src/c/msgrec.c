@@ -0,0 +1,110 @@
+#include <pebble.h>
+#include "msgrec.h"
+#include "trace.h"
+
+// App Message recorder (enable with the MSG_RECORD define in common.h)
+// Every message to and from the phone is copied, in its dictionary wire format, into a fixed ring
+// buffer (the oldest messages are dropped when it fills). The recording is written to the log when
+// the app exits, one message per line:
+//   MSG <ms since first message> <'>' watch to phone or '<' phone to watch> <dictionary in hex>
+// with long messages continued on 'MSG+ <hex>' lines. The phone JS logs the same lines (with the
+// payload as JSON) when its MSG_RECORD flag is set, and host/replay feeds either into the app.
+
+#define MSGREC_BUFFER_SIZE 2048
+#define MSGREC_HEX_PER_LINE 96
+
+#ifdef MSG_RECORD
+
+// Header stored in front of each message in the ring buffer
+typedef struct {
+  uint32_t time;
+  uint16_t size;
+  uint8_t direction;
+} msgrec_header_t;
+
+static uint8_t s_buffer[MSGREC_BUFFER_SIZE];
+static uint16_t s_head = 0;
+static uint16_t s_used = 0;
+static uint32_t s_start = 0;
+static bool s_started = false;
+
+// Size of a dictionary in its wire format (a count byte then tuples with a 7 byte header)
+static uint16_t dict_size(DictionaryIterator *iter) {
+  uint8_t *data = (uint8_t*)iter->dictionary;
+  uint16_t size = 1;
+  for (uint8_t i = 0; i < data[0]; i++)
+    size += 7 + (data[size + 5] | (data[size + 6] << 8));
+  return size;
+}
+
+static void ring_read(uint16_t pos, void *dest, uint16_t length) {
+  for (uint16_t i = 0; i < length; i++)
+    ((uint8_t*)dest)[i] = s_buffer[(pos + i) % MSGREC_BUFFER_SIZE];
+}
+
+static void ring_write(const void *src, uint16_t length) {
+  uint16_t pos = (s_head + s_used) % MSGREC_BUFFER_SIZE;
+  for (uint16_t i = 0; i < length; i++)
+    s_buffer[(pos + i) % MSGREC_BUFFER_SIZE] = ((uint8_t*)src)[i];
+  s_used += length;
+}
+
+// Drop the oldest message
+static void ring_drop(void) {
+  msgrec_header_t header;
+  ring_read(s_head, &header, sizeof(header));
+  s_head = (s_head + sizeof(header) + header.size) % MSGREC_BUFFER_SIZE;
+  s_used -= sizeof(header) + header.size;
+}
+
+// Record a message sent to or received from the phone
+void msgrec_record(MsgDirection direction, DictionaryIterator *iter) {
+  if (iter == NULL || iter->dictionary == NULL) return;
+  uint32_t now = trace_now();
+  if (!s_started) {
+    s_start = now;
+    s_started = true;
+  }
+  msgrec_header_t header = {now - s_start, dict_size(iter), direction};
+  if (sizeof(header) + header.size > MSGREC_BUFFER_SIZE) return;
+  while (s_used + sizeof(header) + header.size > MSGREC_BUFFER_SIZE) ring_drop();
+  ring_write(&header, sizeof(header));
+  ring_write(iter->dictionary, header.size);
+}
+
+// Write the recorded messages to the log so they can be captured with 'pebble logs'
+void msgrec_dump(void) {
+  static const char hex_digits[] = "0123456789abcdef";
+  char hex[MSGREC_HEX_PER_LINE * 2 + 1];
+  uint16_t pos = s_head;
+  uint16_t remaining = s_used;
+  while (remaining > 0) {
+    msgrec_header_t header;
+    ring_read(pos, &header, sizeof(header));
+    pos = (pos + sizeof(header)) % MSGREC_BUFFER_SIZE;
+    for (uint16_t offset = 0; offset < header.size; offset += MSGREC_HEX_PER_LINE) {
+      uint16_t length = header.size - offset;
+      if (length > MSGREC_HEX_PER_LINE) length = MSGREC_HEX_PER_LINE;
+      for (uint16_t i = 0; i < length; i++) {
+        uint8_t byte = s_buffer[(pos + offset + i) % MSGREC_BUFFER_SIZE];
+        hex[i * 2] = hex_digits[byte >> 4];
+        hex[i * 2 + 1] = hex_digits[byte & 0xf];
+      }
+      hex[length * 2] = '\0';
+      if (offset == 0)
+        app_log(APP_LOG_LEVEL_INFO, "msgrec", 0, "MSG %u %c %s", (unsigned)header.time,
+                (header.direction == MDWatchToPhone) ? '>' : '<', hex);
+      else
+        app_log(APP_LOG_LEVEL_INFO, "msgrec", 0, "MSG+ %s", hex);
+    }
+    pos = (pos + header.size) % MSGREC_BUFFER_SIZE;
+    remaining -= sizeof(header) + header.size;
+  }
+}
+
+#else
+
+void msgrec_record(MsgDirection direction, DictionaryIterator *iter) {}
+void msgrec_dump(void) {}
+
+#endif
@@ -0,0 +1,20 @@
+#pragma once
+#include <pebble.h>
+#include "common.h"
+
+// Direction of a recorded App Message
+typedef enum MsgDirection {
+  MDWatchToPhone = 0,
+  MDPhoneToWatch
+} MsgDirection;
+
+#ifdef MSG_RECORD
+#define MSG_RECORD_IN(iter) msgrec_record(MDPhoneToWatch, (iter))
+#define MSG_RECORD_OUT(iter) msgrec_record(MDWatchToPhone, (iter))
+#else
+#define MSG_RECORD_IN(iter)
+#define MSG_RECORD_OUT(iter)
+#endif
+
+void msgrec_record(MsgDirection direction, DictionaryIterator *iter);
+void msgrec_dump(void);
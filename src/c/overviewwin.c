@@ -0,0 +1,362 @@
+#include "overviewwin.h"
+#include "devicecache.h"
+#include "trace.h"
+#include "memstats.h"
+#include "common.h"
+#include <pebble.h>
+
+// Overview window listing every device with its status, so the state of all devices can be
+// checked at a glance. Selecting a device jumps to its card on the main window.
+// Scenes listed above the devices change many devices at once, showing their combined progress.
+
+#define ROW_HEIGHT 36
+#define GLYPH_RADIUS 5
+#define GLYPH_WIDTH 20
+
+#define PROGRESS_HEIGHT 3
+
+// How long a scene may go without a progress report before it is given up on: the phone gives up on
+// its devices after 60 seconds (SCENE_TIMEOUT_MS in main.js), plus a margin for the messages
+#define SCENE_TIMEOUT_MS (60000 + 15000)
+
+// Menu sections
+#define SECTION_SCENES 0
+#define SECTION_DEVICES 1
+#ifdef TRACE
+#define SECTION_DIAGNOSTICS 2
+#define SECTION_COUNT 3
+#else
+#define SECTION_COUNT 2
+#endif
+
+// Scenes in menu order, with the type of device each changes and the status it changes them to
+typedef struct {
+  SceneID scene_id;
+  char *title;
+  DeviceType device_type;
+  DeviceStatus target;
+  char *changed_desc;
+} SceneDef;
+
+static const SceneDef s_scene_defs[SCENE_COUNT] = {
+  {SceneCloseAll, "Close all doors", DTGarageDoor, DSClosed, "open"},
+  {SceneLightsOff, "All lights off", DTLightSwitch, DSOff, "on"}
+};
+
+// Progress of each scene, as last reported by the phone (total is -1 until the first report)
+typedef struct {
+  bool started;
+  int done;
+  int total;
+  int failed;
+} SceneProgress;
+
+static SceneProgress s_scene_progress[SCENE_COUNT];
+static AppTimer *s_scene_timers[SCENE_COUNT];
+
+static UIOverviewSelectCallback s_select_callback;
+static UIOverviewSceneCallback s_scene_callback;
+
+static Window *s_window;
+static MenuLayer *s_menu_layer;
+
+// Draw a compact glyph for a device status:
+// Filled = On/Open, Outline = Off/Closed, Outline with centre dot = changing, Nothing = unknown
+static void draw_status_glyph(GContext *ctx, GPoint centre, DeviceStatus status) {
+  switch (status) {
+    case DSOnOpen:
+    case DSVGDOOpen:
+      graphics_fill_circle(ctx, centre, GLYPH_RADIUS);
+      break;
+    case DSOff:
+    case DSClosed:
+      graphics_draw_circle(ctx, centre, GLYPH_RADIUS);
+      break;
+    case DSOpening:
+    case DSClosing:
+    case DSTurningOn:
+    case DSTurningOff:
+      graphics_draw_circle(ctx, centre, GLYPH_RADIUS);
+      graphics_fill_circle(ctx, centre, GLYPH_RADIUS/2);
+      break;
+    default:
+      break;
+  }
+}
+
+static uint16_t menu_get_num_sections(MenuLayer *menu_layer, void *data) {
+  return SECTION_COUNT;
+}
+
+// Index of a scene in the menu, or -1 if unknown
+static int scene_index(SceneID scene_id) {
+  for (int i = 0; i < SCENE_COUNT; i++)
+    if (s_scene_defs[i].scene_id == scene_id) return i;
+  return -1;
+}
+
+static bool scene_running(int index) {
+  SceneProgress *progress = &s_scene_progress[index];
+  return progress->started && (progress->total < 0 || progress->done < progress->total);
+}
+
+// Number of devices a scene would change, going by their cached status
+static int scene_device_count(const SceneDef *scene) {
+  int count = 0;
+  for (int i = 0; i < g_device_count; i++) {
+    DeviceCacheEntry *entry = devicecache_get(i);
+    if (entry != NULL && entry->has_details && entry->device_type == scene->device_type &&
+        entry->status >= DSOff && entry->status != scene->target)
+      count++;
+  }
+  return count;
+}
+
+static uint16_t menu_get_num_rows(MenuLayer *menu_layer, uint16_t section_index, void *data) {
+  switch (section_index) {
+    case SECTION_SCENES:
+      return SCENE_COUNT;
+    case SECTION_DEVICES:
+      return g_device_count;
+#ifdef TRACE
+    case SECTION_DIAGNOSTICS:
+      return 2;
+#endif
+    default:
+      return 0;
+  }
+}
+
+static int16_t menu_get_header_height(MenuLayer *menu_layer, uint16_t section_index, void *data) {
+  return PBL_IF_RECT_ELSE(MENU_CELL_BASIC_HEADER_HEIGHT, 0);
+}
+
+static int16_t menu_get_cell_height(MenuLayer *menu_layer, MenuIndex *cell_index, void *data) {
+  return ROW_HEIGHT;
+}
+
+static void menu_draw_header(GContext *ctx, const Layer *cell_layer, uint16_t section_index, void *data) {
+  switch (section_index) {
+    case SECTION_SCENES:
+      menu_cell_basic_header_draw(ctx, cell_layer, "Scenes");
+      break;
+    case SECTION_DEVICES:
+      menu_cell_basic_header_draw(ctx, cell_layer, "Devices");
+      break;
+#ifdef TRACE
+    case SECTION_DIAGNOSTICS:
+      menu_cell_basic_header_draw(ctx, cell_layer, "Diagnostics");
+      break;
+#endif
+  }
+}
+
+// Draw a device row with the name, location and a status glyph
+static void draw_device_row(GContext *ctx, const Layer *cell_layer, int device_index) {
+  GRect bounds = layer_get_bounds(cell_layer);
+  DeviceCacheEntry *entry = devicecache_get(device_index);
+  bool highlighted = menu_cell_layer_is_highlighted(cell_layer);
+  GColor color = highlighted ? GColorWhite : GColorBlack;
+  int16_t inset = PBL_IF_RECT_ELSE(4, 20);
+  GRect text_rect = GRect(inset, -2, bounds.size.w - GLYPH_WIDTH - inset - 2, 20);
+  
+  graphics_context_set_text_color(ctx, color);
+  graphics_context_set_stroke_color(ctx, color);
+  graphics_context_set_fill_color(ctx, color);
+  
+  if (entry != NULL && entry->has_details) {
+    graphics_draw_text(ctx, strarena_get(entry->name), fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD), text_rect,
+                       GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+    text_rect.origin.y += 18;
+    text_rect.size.h = 16;
+    graphics_draw_text(ctx, strarena_get(entry->location), fonts_get_system_font(FONT_KEY_GOTHIC_14), text_rect,
+                       GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+    draw_status_glyph(ctx, GPoint(bounds.size.w - inset - GLYPH_RADIUS - 2, bounds.size.h/2), entry->status);
+  } else {
+    graphics_draw_text(ctx, "Loading...", fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD), text_rect,
+                       GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+  }
+}
+
+// Draw a scene row with its title, what it will change or its progress, and a progress bar while running
+static void draw_scene_row(GContext *ctx, const Layer *cell_layer, int index) {
+  GRect bounds = layer_get_bounds(cell_layer);
+  const SceneDef *scene = &s_scene_defs[index];
+  SceneProgress *progress = &s_scene_progress[index];
+  bool highlighted = menu_cell_layer_is_highlighted(cell_layer);
+  GColor color = highlighted ? GColorWhite : GColorBlack;
+  int16_t inset = PBL_IF_RECT_ELSE(4, 20);
+  GRect text_rect = GRect(inset, -2, bounds.size.w - inset * 2, 20);
+  char desc[32];
+  
+  if (!progress->started) {
+    int count = scene_device_count(scene);
+    if (count > 0)
+      snprintf(desc, sizeof(desc), "%d %s", count, scene->changed_desc);
+    else
+      snprintf(desc, sizeof(desc), "None %s", scene->changed_desc);
+  } else if (progress->total < 0) {
+    strcpy(desc, "Starting...");
+  } else if (progress->total == 0) {
+    // (A scene the phone could not run, e.g. as another scene is running, fails without any devices)
+    strcpy(desc, (progress->failed > 0) ? "Could not start" : "Nothing to change");
+  } else if (progress->done < progress->total) {
+    snprintf(desc, sizeof(desc), "%d of %d done", progress->done, progress->total);
+  } else if (progress->failed > 0) {
+    snprintf(desc, sizeof(desc), "%d of %d failed", progress->failed, progress->total);
+  } else {
+    strcpy(desc, "All done");
+  }
+  
+  graphics_context_set_text_color(ctx, color);
+  graphics_context_set_fill_color(ctx, color);
+  graphics_draw_text(ctx, scene->title, fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD), text_rect,
+                     GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+  text_rect.origin.y += 18;
+  text_rect.size.h = 16;
+  graphics_draw_text(ctx, desc, fonts_get_system_font(FONT_KEY_GOTHIC_14), text_rect,
+                     GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+  
+  if (scene_running(index) && progress->total > 0) {
+    int16_t width = (bounds.size.w - inset * 2) * progress->done / progress->total;
+    graphics_fill_rect(ctx, GRect(inset, bounds.size.h - PROGRESS_HEIGHT, width, PROGRESS_HEIGHT), 0, GCornerNone);
+  }
+}
+
+static void menu_draw_row(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *data) {
+  switch (cell_index->section) {
+    case SECTION_SCENES:
+      draw_scene_row(ctx, cell_layer, cell_index->row);
+      break;
+    case SECTION_DEVICES:
+      draw_device_row(ctx, cell_layer, cell_index->row);
+      break;
+#ifdef TRACE
+    case SECTION_DIAGNOSTICS:
+      menu_cell_basic_draw(ctx, cell_layer, (cell_index->row == 0) ? "Trace" : "Memory", NULL, NULL);
+      break;
+#endif
+  }
+}
+
+// Give up on a scene the phone has stopped reporting progress of (e.g. the message was lost), so it
+// can be started again
+static void scene_timed_out(void *data) {
+  int index = (int)(intptr_t)data;
+  s_scene_timers[index] = NULL;
+  s_scene_progress[index].started = false;
+  overview_refresh();
+}
+
+// Start, restart or cancel the timeout of a scene, depending on whether it is running
+static void update_scene_timer(int index) {
+  if (s_scene_timers[index] != NULL) {
+    app_timer_cancel(s_scene_timers[index]);
+    s_scene_timers[index] = NULL;
+  }
+  if (scene_running(index))
+    s_scene_timers[index] = app_timer_register(SCENE_TIMEOUT_MS, scene_timed_out, (void *)(intptr_t)index);
+}
+
+static void menu_select_click(MenuLayer *menu_layer, MenuIndex *cell_index, void *data) {
+  switch (cell_index->section) {
+    case SECTION_SCENES:
+      // Start the scene unless it is already running
+      if (!scene_running(cell_index->row) && s_scene_callback != NULL) {
+        s_scene_progress[cell_index->row] = (SceneProgress) { .started = true, .total = -1 };
+        update_scene_timer(cell_index->row);
+        menu_layer_reload_data(s_menu_layer);
+        s_scene_callback(s_scene_defs[cell_index->row].scene_id);
+      }
+      break;
+    case SECTION_DEVICES:
+      if (s_select_callback != NULL) s_select_callback(cell_index->row);
+      break;
+#ifdef TRACE
+    case SECTION_DIAGNOSTICS:
+      if (cell_index->row == 0)
+        trace_show();
+      else
+        memstats_show();
+      break;
+#endif
+  }
+}
+
+static void initialise_ui(void) {
+  s_window = window_create();
+  Layer *root_layer = window_get_root_layer(s_window);
+  GRect bounds = layer_get_bounds(root_layer); 
+  IF_2(window_set_fullscreen(s_window, true));
+  
+  // s_menu_layer
+  s_menu_layer = menu_layer_create(bounds);
+  menu_layer_set_callbacks(s_menu_layer, NULL, (MenuLayerCallbacks) {
+    .get_num_sections = menu_get_num_sections,
+    .get_num_rows = menu_get_num_rows,
+    .get_header_height = menu_get_header_height,
+    .get_cell_height = menu_get_cell_height,
+    .draw_header = menu_draw_header,
+    .draw_row = menu_draw_row,
+    .select_click = menu_select_click
+  });
+  IF_3(menu_layer_set_highlight_colors(s_menu_layer, COLOR_FALLBACK(GColorBulgarianRose, GColorBlack), GColorWhite));
+  menu_layer_set_click_config_onto_window(s_menu_layer, s_window);
+  layer_add_child(root_layer, menu_layer_get_layer(s_menu_layer));
+}
+
+static void destroy_ui(void) {
+  window_destroy(s_window);
+  menu_layer_destroy(s_menu_layer);
+}
+
+static void handle_window_unload(Window* window) {
+  destroy_ui();
+  s_window = NULL;
+}
+
+void overview_register_select(UIOverviewSelectCallback callback) {
+  s_select_callback = callback;
+}
+
+void overview_register_scene(UIOverviewSceneCallback callback) {
+  s_scene_callback = callback;
+}
+
+// Redraw the list with the latest cached device details/statuses
+void overview_refresh(void) {
+  if (showing_overviewwin()) menu_layer_reload_data(s_menu_layer);
+}
+
+// Show the progress of a scene reported by the phone
+void overview_set_scene_progress(SceneID scene_id, int done, int total, int failed) {
+  int index = scene_index(scene_id);
+  if (index < 0) return;
+  s_scene_progress[index] = (SceneProgress) { .started = true, .done = done, .total = total, .failed = failed };
+  update_scene_timer(index);
+  overview_refresh();
+}
+
+// Show the overview window, with the selected device highlighted
+void show_overviewwin(void) {
+  // Results of scenes that have finished are only shown until the window is closed
+  for (int i = 0; i < SCENE_COUNT; i++)
+    if (!scene_running(i)) s_scene_progress[i].started = false;
+  initialise_ui();
+  window_set_window_handlers(s_window, (WindowHandlers) {
+    .unload = handle_window_unload,
+  });
+  if (g_device_selected < g_device_count)
+    menu_layer_set_selected_index(s_menu_layer, (MenuIndex) { .section = SECTION_DEVICES, .row = g_device_selected }, 
+                                  MenuRowAlignCenter, false);
+  window_stack_push(s_window, true);
+}
+
+void hide_overviewwin(void) {
+  if (showing_overviewwin()) window_stack_remove(s_window, true);
+}
+
+// Indicates if the overview window is on the window stack
+bool showing_overviewwin(void) {
+  return (s_window != NULL && window_stack_contains_window(s_window));
+}
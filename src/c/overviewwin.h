@@ -0,0 +1,14 @@
+#pragma once
+#include "common.h"
+
+typedef void (*UIOverviewSelectCallback)(int device_index);
+typedef void (*UIOverviewSceneCallback)(SceneID scene_id);
+
+void overview_register_select(UIOverviewSelectCallback callback);
+void overview_register_scene(UIOverviewSceneCallback callback);
+void overview_refresh(void);
+void overview_set_scene_progress(SceneID scene_id, int done, int total, int failed);
+
+void show_overviewwin(void);
+void hide_overviewwin(void);
+bool showing_overviewwin(void);
@@ -0,0 +1,98 @@
+#include <pebble.h>
+#include "strarena.h"
+#include "memstats.h"
+
+// Arena of interned strings for device names and locations.
+// Each distinct string is stored once (e.g. a location shared by many devices) and referred to by
+// a small handle, so strings do not need to be copied into fixed size fields at every hop.
+// Strings are not removed one by one, but as they are interned the arena only grows with new distinct
+// strings, and it is emptied (strarena_reset) when a new device list replaces every device.
+// The arena grows within the heap budget, up to the largest size 16 bit handles can address.
+
+#define ARENA_INITIAL_SIZE 256
+#define ARENA_MAX_SIZE UINT16_MAX
+
+static char *s_arena = NULL;
+static uint16_t s_arena_size = 0;
+static uint16_t s_arena_used = 0;
+
+// Make room for the given number of bytes, growing the arena if needed
+static bool reserve(uint16_t length) {
+  if (s_arena_used + length <= s_arena_size) return true;
+  
+  uint32_t needed = (uint32_t)s_arena_used + length;
+  if (needed > ARENA_MAX_SIZE) return false;
+  uint32_t new_size = (s_arena_size == 0) ? ARENA_INITIAL_SIZE : s_arena_size * 2;
+  while (new_size < needed) new_size *= 2;
+  if (new_size > ARENA_MAX_SIZE) new_size = ARENA_MAX_SIZE;
+  // Grow only as much as is needed when doubling would exceed the heap budget
+  if (!memstats_can_alloc(new_size - s_arena_size)) new_size = needed;
+  if (!memstats_can_alloc(new_size - s_arena_size)) return false;
+  
+  char *new_arena = realloc(s_arena, new_size);
+  if (new_arena == NULL) return false;
+  memstats_add(MSDevices, new_size - s_arena_size);
+  s_arena = new_arena;
+  s_arena_size = new_size;
+  return true;
+}
+
+// Store a string in the arena (or find the existing copy) and return its handle
+// (Returns STR_EMPTY if the arena is full or there is no heap for it, which is counted in memstats)
+StrHandle strarena_intern(const char *str) {
+  if (str == NULL || str[0] == '\0') return STR_EMPTY;
+  
+  // The empty string is always at the start of the arena
+  if (s_arena_used == 0) {
+    if (!reserve(1)) {
+      memstats_alloc_failed(MSDevices);
+      return STR_EMPTY;
+    }
+    s_arena[0] = '\0';
+    s_arena_used = 1;
+  }
+  
+  // Look for an existing copy
+  uint16_t pos = 1;
+  while (pos < s_arena_used) {
+    if (strcmp(&s_arena[pos], str) == 0) return pos;
+    pos += strlen(&s_arena[pos]) + 1;
+  }
+  
+  uint16_t length = strlen(str) + 1;
+  if (!reserve(length)) {
+    memstats_alloc_failed(MSDevices);
+    return STR_EMPTY;
+  }
+  StrHandle handle = s_arena_used;
+  memcpy(&s_arena[handle], str, length);
+  s_arena_used += length;
+  return handle;
+}
+
+// Get the string for a handle
+const char* strarena_get(StrHandle handle) {
+  if (s_arena == NULL || handle >= s_arena_used) return "";
+  return &s_arena[handle];
+}
+
+// Bytes of the arena holding strings
+uint16_t strarena_used() {
+  return s_arena_used;
+}
+
+// Remove every string (keeping the arena's memory). Handles from before are no longer valid, so
+// nothing may still hold one
+void strarena_reset() {
+  s_arena_used = 0;
+}
+
+void strarena_destroy() {
+  if (s_arena != NULL) {
+    free(s_arena);
+    s_arena = NULL;
+    memstats_add(MSDevices, -s_arena_size);
+  }
+  s_arena_size = 0;
+  s_arena_used = 0;
+}
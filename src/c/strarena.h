@@ -0,0 +1,14 @@
+#pragma once
+#include <pebble.h>
+
+// Handle to a string stored in the string arena (an offset, so it stays valid when the arena grows)
+typedef uint16_t StrHandle;
+
+// Handle of the empty string
+#define STR_EMPTY 0
+
+StrHandle strarena_intern(const char *str);
+const char* strarena_get(StrHandle handle);
+uint16_t strarena_used();
+void strarena_reset();
+void strarena_destroy();
@@ -0,0 +1,122 @@
+#include <pebble.h>
+#include "trace.h"
+#include "debugwin.h"
+
+// Lightweight input-to-paint latency tracing (enable with the TRACE define in common.h)
+// Events are timestamped into a fixed ring buffer so tracing never allocates while running.
+// Update proc durations are kept as running statistics rather than events so that
+// animations do not flush the interesting events out of the buffer.
+
+#define TRACE_BUFFER_SIZE 48
+
+// Returns milliseconds from an arbitrary epoch (wraps, so only use for differences)
+uint32_t trace_now(void) {
+  time_t seconds;
+  uint16_t millis;
+  time_ms(&seconds, &millis);
+  return ((uint32_t)seconds * 1000) + millis;
+}
+
+#ifdef TRACE
+
+typedef struct {
+  uint32_t time;
+  int32_t arg;
+  uint8_t type;
+} trace_event_t;
+
+typedef struct {
+  uint16_t count;
+  uint16_t last;
+  uint16_t max;
+  uint32_t total;
+} trace_duration_t;
+
+static trace_event_t s_events[TRACE_BUFFER_SIZE];
+static uint8_t s_next = 0;
+static uint8_t s_used = 0;
+static trace_duration_t s_durations[TE_DURATION_COUNT];
+static char s_text[TRACE_BUFFER_SIZE * 26 + TE_DURATION_COUNT * 40];
+
+static const char *s_event_names[TECount] = {
+  "Click Up",
+  "Click Down",
+  "Click Sel",
+  "Card Reset",
+  "Det Fetch",
+  "Stat Fetch",
+  "Det Drawn",
+  "Stat Drawn",
+  "Card",
+  "Card Text",
+  "Card Status",
+  "Card Icon",
+  "Spots"
+};
+
+static void record_duration(trace_duration_t *duration, int32_t ms) {
+  duration->count++;
+  duration->last = ms;
+  duration->total += ms;
+  if (ms > duration->max) duration->max = ms;
+}
+
+// Record an event with an argument (device ID, index or duration in ms depending on the event)
+void trace_event(TraceEventType type, int32_t arg) {
+  if (type >= TE_FIRST_DURATION) {
+    record_duration(&s_durations[type - TE_FIRST_DURATION], arg);
+    return;
+  }
+  s_events[s_next].time = trace_now();
+  s_events[s_next].arg = arg;
+  s_events[s_next].type = type;
+  s_next = (s_next + 1) % TRACE_BUFFER_SIZE;
+  if (s_used < TRACE_BUFFER_SIZE) s_used++;
+}
+
+// Build the trace text with each event shown as ms since the preceding click
+static void build_text(void) {
+  int len = 0;
+  s_text[0] = '\0';
+  for (int i = 0; i < TE_DURATION_COUNT; i++) {
+    trace_duration_t *duration = &s_durations[i];
+    len += snprintf(s_text + len, sizeof(s_text) - len, "%s: %d avg %d max %dms\n",
+                    s_event_names[TE_FIRST_DURATION + i], duration->last,
+                    duration->count ? (int)(duration->total / duration->count) : 0, duration->max);
+  }
+  uint32_t click_time = 0;
+  for (int i = 0; i < s_used && len < (int)sizeof(s_text); i++) {
+    trace_event_t *event = &s_events[(s_next + TRACE_BUFFER_SIZE - s_used + i) % TRACE_BUFFER_SIZE];
+    if (event->type <= TEClickSelect || click_time == 0) click_time = event->time;
+    len += snprintf(s_text + len, sizeof(s_text) - len, "+%d %s %d\n", 
+                    (int)(event->time - click_time), s_event_names[event->type], (int)event->arg);
+  }
+}
+
+// Write the trace to the log so it can be captured with 'pebble logs'
+void trace_dump(void) {
+  build_text();
+  char *line = s_text;
+  while (*line != '\0') {
+    char *end = strchr(line, '\n');
+    if (end != NULL) *end = '\0';
+    app_log(APP_LOG_LEVEL_INFO, "trace", 0, "%s", line);
+    if (end == NULL) break;
+    *end = '\n';
+    line = end + 1;
+  }
+}
+
+// Show the trace on the watch (also dumped to the log)
+void trace_show(void) {
+  trace_dump();
+  show_debugwin("Trace", s_text);
+}
+
+#else
+
+void trace_event(TraceEventType type, int32_t arg) {}
+void trace_dump(void) {}
+void trace_show(void) {}
+
+#endif
@@ -0,0 +1,40 @@
+#pragma once
+#include <pebble.h>
+#include "common.h"
+
+// Events recorded by the input-to-paint latency trace
+typedef enum TraceEventType {
+  TEClickUp = 0,
+  TEClickDown,
+  TEClickSelect,
+  TECardReset,
+  TEDetailsFetchSent,
+  TEStatusFetchSent,
+  TEDetailsRendered,
+  TEStatusRendered,
+  // Update proc durations (kept as statistics, one per drawn region)
+  TECardUpdateProc,
+  TECardTextProc,
+  TECardStatusProc,
+  TECardIconProc,
+  TESpotsUpdateProc,
+  TECount
+} TraceEventType;
+
+#define TE_FIRST_DURATION TECardUpdateProc
+#define TE_DURATION_COUNT (TECount - TE_FIRST_DURATION)
+
+#ifdef TRACE
+#define TRACE_EVENT(type, arg) trace_event((type), (arg))
+#define TRACE_START(var) uint32_t var = trace_now()
+#define TRACE_DURATION(type, var) trace_event((type), (int32_t)(trace_now() - (var)))
+#else
+#define TRACE_EVENT(type, arg)
+#define TRACE_START(var)
+#define TRACE_DURATION(type, var)
+#endif
+
+uint32_t trace_now(void);
+void trace_event(TraceEventType type, int32_t arg);
+void trace_dump(void);
+void trace_show(void);
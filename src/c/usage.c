@@ -0,0 +1,115 @@
+#include <pebble.h>
+#include "usage.h"
+
+// How often each device is operated, kept in persistent storage so that the devices used most (and
+// most recently) can be listed first. Only the USAGE_MAX most used devices are kept, so the table
+// fits in a single persistent storage key
+
+#define PERSIST_USAGE 1
+#define USAGE_VERSION 1
+#define USAGE_MAX 20
+// Uses count half as much for every week since the device was last used
+#define USAGE_HALF_LIFE (7 * 24 * 60 * 60)
+
+typedef struct {
+  int32_t device_id;
+  uint16_t count;
+  uint32_t last_used;
+} UsageRecord;
+
+typedef struct {
+  uint8_t version;
+  uint8_t count;
+  UsageRecord records[USAGE_MAX];
+} UsageTable;
+
+static UsageTable s_usage;
+static bool s_usage_changed = false;
+
+// Load the usage table (starting afresh if there is none or it has an older layout)
+void usage_init() {
+  memset(&s_usage, 0, sizeof(s_usage));
+  if (persist_read_data(PERSIST_USAGE, &s_usage, sizeof(s_usage)) != (int)sizeof(s_usage) ||
+      s_usage.version != USAGE_VERSION || s_usage.count > USAGE_MAX) {
+    memset(&s_usage, 0, sizeof(s_usage));
+    s_usage.version = USAGE_VERSION;
+  }
+  s_usage_changed = false;
+}
+
+// Rank of a usage record (the use count halved for each week since the last use)
+static uint32_t usage_score(const UsageRecord *record, time_t now) {
+  time_t age = (now > (time_t)record->last_used) ? now - record->last_used : 0;
+  time_t half_lives = age / USAGE_HALF_LIFE;
+  return (half_lives < 16) ? ((uint32_t)record->count << 16) >> half_lives : 0;
+}
+
+// Indicates if record a ranks above record b (more recently used when their scores are equal)
+static bool usage_ranks_above(const UsageRecord *a, const UsageRecord *b, time_t now) {
+  uint32_t score_a = usage_score(a, now);
+  uint32_t score_b = usage_score(b, now);
+  return (score_a != score_b) ? score_a > score_b : a->last_used > b->last_used;
+}
+
+// Count a use of a device (replacing the lowest ranked device once the table is full)
+void usage_record(int device_id) {
+  time_t now = time(NULL);
+  UsageRecord *record = NULL;
+  for (int i = 0; i < s_usage.count && record == NULL; i++) {
+    if (s_usage.records[i].device_id == device_id) record = &s_usage.records[i];
+  }
+  if (record == NULL) {
+    if (s_usage.count < USAGE_MAX) {
+      record = &s_usage.records[s_usage.count++];
+    } else {
+      record = &s_usage.records[0];
+      for (int i = 1; i < s_usage.count; i++) {
+        if (usage_ranks_above(record, &s_usage.records[i], now)) record = &s_usage.records[i];
+      }
+    }
+    record->device_id = device_id;
+    record->count = 0;
+  }
+  if (record->count == UINT16_MAX) {
+    // Keep the proportions between devices once a count would overflow
+    for (int i = 0; i < s_usage.count; i++) s_usage.records[i].count /= 2;
+  }
+  record->count++;
+  record->last_used = now;
+  s_usage_changed = true;
+}
+
+// Order a device ID list with the highest ranked devices first (devices that have not been used keep
+// their order after them)
+void usage_sort(int *device_ids, int count) {
+  time_t now = time(NULL);
+  // Rank the usage records, highest first
+  int ranked[USAGE_MAX];
+  for (int i = 0; i < s_usage.count; i++) {
+    int j = i;
+    for (; j > 0 && usage_ranks_above(&s_usage.records[i], &s_usage.records[ranked[j - 1]], now); j--)
+      ranked[j] = ranked[j - 1];
+    ranked[j] = i;
+  }
+  // Move the listed devices to the front in rank order
+  int front = 0;
+  for (int r = 0; r < s_usage.count; r++) {
+    // Devices not used for months are no longer ranked
+    if (usage_score(&s_usage.records[ranked[r]], now) == 0) break;
+    int device_id = s_usage.records[ranked[r]].device_id;
+    for (int i = front; i < count; i++) {
+      if (device_ids[i] == device_id) {
+        memmove(&device_ids[front + 1], &device_ids[front], (i - front) * sizeof(int));
+        device_ids[front++] = device_id;
+        break;
+      }
+    }
+  }
+}
+
+// Write the usage table to persistent storage if it has changed
+void usage_save() {
+  if (!s_usage_changed) return;
+  persist_write_data(PERSIST_USAGE, &s_usage, sizeof(s_usage));
+  s_usage_changed = false;
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include <pebble.h>
+
+void usage_init();
+void usage_record(int device_id);
+void usage_sort(int *device_ids, int count);
+void usage_save();
@@ -1,5 +1,6 @@
 var DEBUG = false;
 var SIMULATE = false;
+var MSG_RECORD = false;
 var version = 'v2.5';
 
 /* Credit goes to https://github.com/arraylabs/myq/ for  
@@ -32,7 +33,10 @@ var Function_Key = {
   DeviceList: 1,
   DeviceDetails: 2,
   GetStatus: 3,
-  SetStatus: 4
+  SetStatus: 4,
+  DeviceSummary: 5,
+  Scene: 6,
+  DeviceChanges: 7
 };
 
 // MyQ device type enum (not the same as the type IDs returned from MyQ servers)
@@ -45,6 +49,7 @@ var Device_Type = {
 
 // MyQ device status (same as MyQ Garage Door status at least)
 var Device_Status = {
+  Loading: -2,  // Status not known (e.g. the device has no status attribute)
   Off: 0,
   OnOpen: 1,
   Closed: 2,
@@ -53,13 +58,63 @@ var Device_Status = {
   VGDOOpen: 9
 };
 
+// Scenes that change many devices with one command (must match the SceneID enum in the watch app)
+var Scene_ID = {
+  CloseAll: 1,
+  LightsOff: 2
+};
+
+// Registry of the device types the app supports, in the order they are matched against MyQ devices
+// (the first matcher to accept a device decides its type). Matchers are compiled once here and
+// match on the MyQ TypeName or TypeId, optionally rejecting names and checking the attributes.
+// Each type has the attributes holding and setting its status, how often it is polled while
+// changing (the watch app has matching poll profiles) and the status each scene changes it to.
+var DEVICE_TYPES = [
+  {type: Device_Type.GarageDoor,
+   label: "Garage Door",
+   matchers: [
+     // MyQ Garage Door openers have "garage door" in the TypeName or TypeID of 47
+     {typeName: /garage\s*door/i, typeIds: [47]},
+     // "MyQ Garage" devices for 3rd party devices have VGDO in the TypeName or TypeID of 259 and a
+     //  'oemtransmitter' attribute value that is not 255 if they have one (filters out the duplicate)
+     {typeName: /gdo/i, notTypeName: /gateway/i, typeIds: [259],
+      accept: function(attrs) { return (!attrs.oemtransmitter || attrs.oemtransmitter.Value != 255) &&
+                                       attrs.desc && attrs.desc.Value; }}
+   ],
+   statusAttr: "doorstate",
+   desiredAttr: "desireddoorstate",
+   poll: {firstCheck: 10000, interval: 2000},
+   scenes: [{id: Scene_ID.CloseAll, status: Device_Status.Closed}]},
+  {type: Device_Type.LightSwitch,
+   label: "Light Switch",
+   matchers: [{typeName: /light|lamp/i, typeIds: [48]}],
+   statusAttr: "lightstate",
+   desiredAttr: "desiredlightstate",
+   poll: {firstCheck: 3000, interval: 2000},
+   scenes: [{id: Scene_ID.LightsOff, status: Device_Status.Off}]},
+  {type: Device_Type.Gate,
+   label: "Gate",
+   // (Whole word only, so gateways are not matched)
+   matchers: [{typeName: /\bgate\b/i, typeIds: []}],
+   statusAttr: "doorstate",
+   desiredAttr: "desireddoorstate",
+   poll: {firstCheck: 15000, interval: 2000},
+   scenes: []}
+];
+
+// Device type descriptors by Device_Type
+var deviceTypes = {};
+for (var dt = 0; dt < DEVICE_TYPES.length; dt++) deviceTypes[DEVICE_TYPES[dt].type] = DEVICE_TYPES[dt];
+
 var salt = "WgGF^*(@!GJEK0fkjGIfy*&*^#&*TJKSFJK357HFQWYFF761YFPSDYbsnabMNBC&*";
-var failCount = 0;
-var loginCount = 0;
 var raw_devices = "";
 
-// Config object that is saved in localStorage (Password is encrypted with AES)
-var config = {username: "", password: "", token: "", sessionStart: null, devices: null};
+// Config object that is saved in localStorage (Passwords are encrypted with AES)
+// Each MyQ account has its own login session, and each device has the index of the account it was listed
+// by (devices are identified by their MyQ device ID, which is unique across accounts, so the device lists
+// of all accounts are merged into one list for the watch)
+// Times (each account's sessionStart and each device's StatusUpdated and StatusChanged) are held as ms since the epoch
+var config = defaultConfig();
 
 // Add an int as 4 bytes to an existing byte array to pass a c-style array to the Pebble
 function appendInt32(byteArray, value) {
@@ -69,14 +124,59 @@ function appendInt32(byteArray, value) {
   byteArray.push((value>>24)&0xff);
 }
 
+// Add a string as null terminated UTF-8 bytes to an existing byte array
+function appendString(byteArray, value) {
+  var utf8 = unescape(encodeURIComponent(value ? value.toString() : ""));
+  for (var i = 0; i < utf8.length; i++) {
+    byteArray.push(utf8.charCodeAt(i));
+  }
+  byteArray.push(0);
+}
+
+// CryptoJS and the passphrase are only set up the first time something is encrypted or decrypted
+// (usually a login), and decrypted credentials are kept for the rest of the JS session (by encrypted value)
+var cryptoJS = null;
+var passphrase = null;
+var credentialCache = {};
+
+// Get CryptoJS, initialising it (see aes.js) when first needed
+function getCryptoJS() {
+  if (!cryptoJS) cryptoJS = loadCryptoJS();
+  return cryptoJS;
+}
+
+// Pebble account token and salt, which is the passphrase for encrypting the password
+function getPassphrase() {
+  if (passphrase === null) passphrase = Pebble.getAccountToken() + salt;
+  return passphrase;
+}
+
+// Forget decrypted credentials (when the settings change)
+function wipeCredentialCache() {
+  credentialCache = {};
+}
+
 // Encrypts a string with AES (see aes.js) using Pebble account token and salt as the passphrase
 function encrypt(input) {
-  return CryptoJS.AES.encrypt(input, Pebble.getAccountToken() + salt).toString();
+  var encrypted = getCryptoJS().AES.encrypt(input, getPassphrase()).toString();
+  credentialCache[encrypted] = input;
+  return encrypted;
 }
 
 // Decrypts a string encrypted with AES (see aes.js) using Pebble account token and salt as the passphrase
+// (empty if it can not be decrypted, e.g. the Pebble account has changed)
 function decrypt(input) {
-  return CryptoJS.AES.decrypt(input, Pebble.getAccountToken() + salt).toString(CryptoJS.enc.Utf8)
+  if (!input) return "";
+  if (!credentialCache.hasOwnProperty(input)) {
+    var decrypted = "";
+    try {
+      decrypted = getCryptoJS().AES.decrypt(input, getPassphrase()).toString(getCryptoJS().enc.Utf8);
+    } catch (err) {
+      if (DEBUG) console.log("Password could not be decrypted: " + err.message);
+    }
+    credentialCache[input] = decrypted;
+  }
+  return credentialCache[input];
 }
 
 // Send error message to watch app
@@ -84,14 +184,131 @@ function sendError(msg) {
   Pebble.sendAppMessage({"function_key": Function_Key.Error, "error_message": msg});
 }
 
-// Load saved config details (login, session token, devices)
+// Version of the layout of the config saved in localStorage. Layouts before versioning (version 1)
+// had the same fields as version 2, but with times saved as date strings by JSON.stringify. Versions 1
+// and 2 had a single account, with its username, password, token and sessionStart in the config itself
+var CONFIG_VERSION = 3;
+
+// (devicesIncomplete is set when the device list is missing an account that could not be listed, so the
+// list is not saved and the next launch lists every account again)
+function defaultConfig() {
+  return {accounts: [], devices: null, devicesIncomplete: false};
+}
+
+// A MyQ account with its login session (failCount and loginCount are only kept for the JS session)
+function newAccount(username, password) {
+  return {username: username, password: password, token: null, sessionStart: null, failCount: 0, loginCount: 0};
+}
+
+// Convert a saved time (ms since the epoch, or a date string from version 1) to ms (null if not valid)
+function parseTime(value) {
+  if (value === null || value === undefined || value === "") return null;
+  var ms = (typeof value == "number") ? value : (new Date(value)).getTime();
+  return isNaN(ms) ? null : ms;
+}
+
+function parseString(value) {
+  return (typeof value == "string") ? value : "";
+}
+
+// Validate a saved device (null if it can not be used)
+function parseDevice(saved) {
+  if (!saved || typeof saved != "object") return null;
+  var deviceID = parseInt(saved.DeviceID);
+  if (isNaN(deviceID)) return null;
+  var type = parseInt(saved.Type);
+  var status = parseInt(saved.Status);
+  return {DeviceID: deviceID,
+          Type: isNaN(type) ? Device_Type.Unknown : type,
+          Location: parseString(saved.Location),
+          Name: parseString(saved.Name),
+          Status: isNaN(status) ? -2 : status,
+          StatusUpdated: parseTime(saved.StatusUpdated) || 0,
+          StatusChanged: parseTime(saved.StatusChanged),
+          Account: parseInt(saved.Account) || 0};
+}
+
+// Validate a saved account (null if it can not be used)
+function parseAccount(saved) {
+  if (!saved || typeof saved != "object" || !parseString(saved.username)) return null;
+  var account = newAccount(saved.username, parseString(saved.password));
+  account.token = parseString(saved.token) || null;
+  account.sessionStart = parseTime(saved.sessionStart);
+  return account;
+}
+
+// Validate saved config (migrating older layouts), falling back to defaults for anything not valid
+function parseConfig(text) {
+  var saved = JSON.parse(text);
+  var parsed = defaultConfig();
+  if (!saved || typeof saved != "object") return parsed;
+  
+  // Versions before 3 had the only account in the config itself
+  var accounts = Array.isArray(saved.accounts) ? saved.accounts : [saved];
+  for (var a = 0; a < accounts.length; a++) {
+    var account = parseAccount(accounts[a]);
+    if (account) parsed.accounts.push(account);
+  }
+  if (Array.isArray(saved.devices)) {
+    parsed.devices = [];
+    for (var i = 0; i < saved.devices.length; i++) {
+      var device = parseDevice(saved.devices[i]);
+      if (device && device.Account < parsed.accounts.length) parsed.devices.push(device);
+    }
+  }
+  return parsed;
+}
+
+// Convert config to the saved layout
+function serializeConfig(config) {
+  var devices = null;
+  if (Array.isArray(config.devices) && !config.devicesIncomplete) {
+    devices = [];
+    for (var i = 0; i < config.devices.length; i++) {
+      var device = config.devices[i];
+      devices.push({DeviceID: device.DeviceID,
+                    Type: device.Type,
+                    Location: device.Location,
+                    Name: device.Name,
+                    Status: device.Status,
+                    StatusUpdated: parseTime(device.StatusUpdated),
+                    StatusChanged: parseTime(device.StatusChanged),
+                    Account: device.Account});
+    }
+  }
+  var accounts = [];
+  for (var a = 0; a < config.accounts.length; a++) {
+    var account = config.accounts[a];
+    accounts.push({username: account.username,
+                   password: account.password,
+                   token: account.token,
+                   sessionStart: parseTime(account.sessionStart)});
+  }
+  return JSON.stringify({version: CONFIG_VERSION,
+                         accounts: accounts,
+                         devices: devices});
+}
+
+// Load saved config details (accounts with their login sessions, devices)
 function loadConfig() {
-  if (localStorage.config) config = JSON.parse(localStorage.config);
+  if (!localStorage.config) return;
+  var layoutVersion = null;
+  try {
+    config = parseConfig(localStorage.config);
+    layoutVersion = JSON.parse(localStorage.config).version;
+  } catch (err) {
+    if (DEBUG) console.log("Saved config not valid: " + err.message);
+    config = defaultConfig();
+  }
+  // Save config from older versions in the current layout
+  if (layoutVersion != CONFIG_VERSION) saveConfig();
 }
 
 // Save config details to phone
+// (Not while a trace is replayed, as the replay changes the devices as if simulating)
 function saveConfig() {
-  localStorage.config = JSON.stringify(config);
+  if (replay) return;
+  localStorage.config = serializeConfig(config);
 }
 
 // Find a device in the locally saved device list by Device ID
@@ -106,62 +323,210 @@ function findDevice(deviceID) {
   }
 }
 
-// Indicates if it looks like we have a valid security token (the server still may reject it with a -3333 error)
-function haveValidToken() {
-  if (config.token && (((new Date()) - new Date(config.sessionStart)) < (1000 * 60 * 20))) {
-    if (DEBUG) console.log("Token age: " + ((new Date()) - new Date(config.sessionStart)));
+// Get the account a device was listed by
+function getDeviceAccount(device) {
+  return config.accounts[device.Account] || null;
+}
+
+// Indicates if any account has both a username and password
+function haveCredentials() {
+  for (var i = 0; i < config.accounts.length; i++) {
+    if (config.accounts[i].username && config.accounts[i].password) return true;
+  }
+  return false;
+}
+
+// Indicates if it looks like an account has a valid security token (the server still may reject it with a -3333 error)
+function haveValidToken(account) {
+  if (account.token && account.sessionStart && ((Date.now() - account.sessionStart) < (1000 * 60 * 20))) {
+    if (DEBUG) console.log("Token age: " + (Date.now() - account.sessionStart));
     return true;
   } else {
     return false;
   }
 }
 
-// Convert time to a phrase used to summarize how long it has been since the time
-function timeToDesc(time) {
+// Convert a time (Date, saved date string or ms) to seconds since the epoch (UTC) for the watch, which
+// describes how long ago it was itself (0 if unknown)
+function timeToEpoch(time) {
   if (time) {
-    var now = new Date();
-    var today = (new Date(now)).setHours(0,0,0,0);
-    var timeDate = (new Date(time)).setHours(0,0,0,0);
-    if (today == timeDate) {
-      var hours = time.getHours();
-      var mins = time.getMinutes();
-      var ampm = hours >= 12 ? 'pm' : 'am';
-      hours = hours % 12;
-      hours = hours ? hours : 12; // the hour '0' should be '12'
-      mins = mins < 10 ? '0'+mins : mins;
-      return "since " + hours + ':' + mins + ampm;
-    } else {
-      var dayDiff = (today-timeDate)/(1000*60*60*24);
-      if (dayDiff == 1)
-        return "since yesterday";
-      else
-        return "for " + dayDiff + " days";
-    }
+    var ms = (new Date(time)).getTime();
+    return isNaN(ms) ? 0 : Math.floor(ms / 1000);
   } else {
-    return "";
+    return 0;
   }
 }
 
-// Make HTTP GET request to a URL. Call 'success' with response JSON on success. Call error on HTTP error
-function getData(url, params, success, error) {
-  var req = new XMLHttpRequest();
-  var timeout = null;
-  
-  req.onload = function(e) {
-    if (req.readyState == 4) {
-      // HTTP request completed
-      clearTimeout(timeout);
-      
-      if (req.status == 200) {
-        if (DEBUG) console.log("GET Response: " + req.responseText);
-        success(JSON.parse(req.responseText));
-      } else {
-        if (DEBUG) console.log("GET Error: " + req.status);
-        error("HTTP error: " + req.status);
-      }
+// Diagnostics kept in localStorage.diagnostics and summarised on the settings page, to tell whether time
+// goes to the server, logging in or Bluetooth. The latest DIAG_SAMPLES of each latency (ms) are kept:
+// 'http:<endpoint>' for each MyQ server request, 'queue' for the wait for a request to start and 'send'
+// for the watch to receive a message. Counts are kept from when the diagnostics were last reset
+var DIAG_SAMPLES = 50;
+var DIAG_SAVE_MS = 5000;
+var DIAG_ENDPOINTS = {};
+DIAG_ENDPOINTS[WS_URL_Login] = "login";
+DIAG_ENDPOINTS[WS_URL_Device_List] = "list";
+DIAG_ENDPOINTS[WS_URL_Device_GetAttr] = "status";
+DIAG_ENDPOINTS[WS_URL_Device_SetAttr] = "set";
+var DIAG_COUNTS = [
+  {name: "logins", label: "Logins"},
+  {name: "tokenFailures", label: "Security token failures (-3333)"},
+  {name: "httpErrors", label: "HTTP errors"},
+  {name: "timeouts", label: "Server timeouts"},
+  {name: "cacheHits", label: "Statuses from cache"},
+  {name: "cacheMisses", label: "Statuses fetched"},
+  {name: "sends", label: "Messages sent to watch"},
+  {name: "sendFailures", label: "Messages failed to send"}
+];
+var diagnostics = defaultDiagnostics();
+var diagnosticsSave = null;
+
+function defaultDiagnostics() {
+  return {since: Date.now(), latency: {}, counts: {}};
+}
+
+function loadDiagnostics() {
+  if (!localStorage.diagnostics) return;
+  try {
+    var saved = JSON.parse(localStorage.diagnostics);
+    diagnostics = {since: saved.since || Date.now(), latency: saved.latency || {}, counts: saved.counts || {}};
+  } catch (err) {
+    if (DEBUG) console.log("Error loading diagnostics: " + err.message);
+  }
+}
+
+// Save the diagnostics shortly after they change (rather than after every request)
+function saveDiagnostics() {
+  if (diagnosticsSave) return;
+  diagnosticsSave = setTimeout(function() {
+    diagnosticsSave = null;
+    localStorage.diagnostics = JSON.stringify(diagnostics);
+  }, DIAG_SAVE_MS);
+}
+
+function diagCount(name) {
+  diagnostics.counts[name] = (diagnostics.counts[name] || 0) + 1;
+  saveDiagnostics();
+}
+
+function diagLatency(name, ms) {
+  var samples = diagnostics.latency[name] || (diagnostics.latency[name] = []);
+  samples.push(ms);
+  if (samples.length > DIAG_SAMPLES) samples.shift();
+  saveDiagnostics();
+}
+
+// Name of the MyQ server endpoint of a URL (without its parameters)
+function diagEndpoint(url) {
+  return DIAG_ENDPOINTS[url.split("?")[0]] || "other";
+}
+
+// Get the value below which a percentage of samples fall
+function percentile(samples, percent) {
+  var sorted = samples.slice().sort(function(a, b) { return a - b; });
+  return sorted[Math.max(0, Math.ceil(sorted.length * percent / 100) - 1)];
+}
+
+// Settings page HTML summarising the diagnostics
+function diagnosticsHtml() {
+  var hours = Math.max((Date.now() - diagnostics.since) / 3600000, 1 / 60);
+  var html = '<table style="font-size: smaller;"><tr><th align="left">Latency (ms)</th><th>Samples</th><th>p50</th><th>p95</th></tr>';
+  var names = Object.keys(diagnostics.latency).sort();
+  for (var i = 0; i < names.length; i++) {
+    var samples = diagnostics.latency[names[i]];
+    if (samples.length === 0) continue;
+    html += '<tr><td>' + names[i] + '</td><td align="right">' + samples.length + '</td><td align="right">' +
+      percentile(samples, 50) + '</td><td align="right">' + percentile(samples, 95) + '</td></tr>';
+  }
+  html += '</table><table style="font-size: smaller;">';
+  for (var c = 0; c < DIAG_COUNTS.length; c++) {
+    html += '<tr><td>' + DIAG_COUNTS[c].label + '</td><td align="right">' + (diagnostics.counts[DIAG_COUNTS[c].name] || 0) + '</td></tr>';
+  }
+  var hits = diagnostics.counts.cacheHits || 0;
+  var lookups = hits + (diagnostics.counts.cacheMisses || 0);
+  html += '<tr><td>Logins per hour</td><td align="right">' + ((diagnostics.counts.logins || 0) / hours).toFixed(1) + '</td></tr>';
+  html += '<tr><td>Status cache hit rate</td><td align="right">' + (lookups ? Math.round(hits * 100 / lookups) + '%' : '-') + '</td></tr>';
+  html += '</table><p style="font-size: smaller;">Since ' + (new Date(diagnostics.since)).toLocaleString() + '</p>';
+  return html;
+}
+
+// Time each message sent to the watch until it is acknowledged, and count the ones that fail
+var sendAppMessageUntimed = Pebble.sendAppMessage;
+Pebble.sendAppMessage = function(payload, success, failure) {
+  var sent = Date.now();
+  diagCount("sends");
+  return sendAppMessageUntimed.call(Pebble, payload,
+                                    function(e) {
+                                      diagLatency("send", Date.now() - sent);
+                                      if (success) success(e);
+                                    },
+                                    function(e) {
+                                      diagCount("sendFailures");
+                                      if (failure) failure(e);
+                                    });
+};
+
+// HTTP requests are queued and started in order of priority (then in the order they were made), with at
+// most MAX_REQUESTS running at once, so a burst of background requests can not hold up a user's command
+// or open many connections at once. Requests made with a key replace a queued request with the same key
+var Request_Priority = {
+  Command: 0,   // Changing a device (and logging in, which everything else waits for)
+  Poll: 1,      // Checking on a device that is changing
+  Status: 2,    // Status of the device the watch is showing, or the device list it is waiting for
+  Prefetch: 3   // Statuses of devices that are not being shown
+};
+var MAX_REQUESTS = 3;
+var requestQueue = [];
+var activeRequests = 0;
+
+// Queue a request. 'start' is called with a function it must call once the request has finished
+function scheduleRequest(priority, key, start) {
+  if (key) cancelRequests(key);
+  requestQueue.push({priority: priority, key: key, start: start, queued: Date.now()});
+  startRequests();
+}
+
+// Remove queued requests that have not started with the given key (superseded by a later request, so
+// their success and error functions are never called)
+function cancelRequests(key) {
+  for (var i = requestQueue.length - 1; i >= 0; i--) {
+    if (requestQueue[i].key == key) {
+      if (DEBUG) console.log("Request cancelled: " + requestQueue[i].key);
+      requestQueue.splice(i, 1);
     }
+  }
+}
+
+// Start the highest priority queued requests while below the limit of requests running at once
+function startRequests() {
+  while (activeRequests < MAX_REQUESTS && requestQueue.length > 0) {
+    var next = 0;
+    for (var i = 1; i < requestQueue.length; i++) {
+      if (requestQueue[i].priority < requestQueue[next].priority) next = i;
+    }
+    var request = requestQueue.splice(next, 1)[0];
+    activeRequests++;
+    diagLatency("queue", Date.now() - request.queued);
+    request.start(requestFinished());
+  }
+}
+
+// Get the function a started request calls once when it has finished (completed, failed or timed out)
+function requestFinished() {
+  var finished = false;
+  return function() {
+    if (finished) return;
+    finished = true;
+    activeRequests--;
+    // Start the next request after the current response has been handled
+    setTimeout(startRequests, 0);
   };
-  
+}
+
+// Make HTTP GET request to a URL in an account's session with a Request_Priority (and optional key, see
+// scheduleRequest). Call 'success' with response JSON on success. Call error on HTTP error
+function getData(account, url, params, success, error, priority, key) {
+  var endpoint = diagEndpoint(url);
   if (params){
     var paramStrings = [];
     for(var paramName in params) {
@@ -171,106 +536,152 @@ function getData(url, params, success, error) {
     url += paramStrings.join("&");
   }
   
-  if (DEBUG) console.log("GETing URL: " + url);
-  
-  // Start 10 second timeout for HTTP request
-  timeout = setTimeout(function() { req.abort(); error("Server communication timed out"); }, 10000);
-  
-  req.open("GET", url, true);
-  
-  // Apply headers
-  for(var headerName in headers) {
-    req.setRequestHeader(headerName, headers[headerName]);
-  }
-  if (haveValidToken()) req.setRequestHeader("SecurityToken", config.token);
-  // Send GET request
-  req.send();
+  scheduleRequest(priority, key, function(done) {
+    var req = new XMLHttpRequest();
+    var timeout = null;
+    var started = Date.now();
+    
+    req.onload = function(e) {
+      if (req.readyState == 4) {
+        // HTTP request completed
+        clearTimeout(timeout);
+        done();
+        
+        diagLatency("http:" + endpoint, Date.now() - started);
+        if (req.status == 200) {
+          if (DEBUG) console.log("GET Response: " + req.responseText);
+          var response = JSON.parse(req.responseText);
+          if (response.ReturnCode == "-3333") diagCount("tokenFailures");
+          success(response);
+        } else {
+          if (DEBUG) console.log("GET Error: " + req.status);
+          diagCount("httpErrors");
+          error("HTTP error: " + req.status);
+        }
+      }
+    };
+    
+    if (DEBUG) console.log("GETing URL: " + url);
+    
+    // Start 10 second timeout for HTTP request
+    timeout = setTimeout(function() { req.abort(); done(); diagCount("timeouts"); error("Server communication timed out"); }, 10000);
+    
+    req.open("GET", url, true);
+    
+    // Apply headers (the session is checked when the request starts, in case it was queued during a login)
+    for(var headerName in headers) {
+      req.setRequestHeader(headerName, headers[headerName]);
+    }
+    if (haveValidToken(account)) req.setRequestHeader("SecurityToken", account.token);
+    // Send GET request
+    req.send();
+  });
 }
 
-// Send a JSON object to a URL using a HTTP POST request. Call 'success' on success and 'error' on HTTP error
+// Send a JSON object to a URL using a HTTP POST request (only used to login, so it has the highest priority).
+// Call 'success' on success and 'error' on HTTP error
 function postData(url, data, success, error) {
-  var req = new XMLHttpRequest();
-  var timeout = null;
-  
-  req.onload = function(e) {
-    if (req.readyState == 4) {
-      // HTTP request completed
-      clearTimeout(timeout);
-      
-      if (req.status == 200) {
-        if (DEBUG) console.log("POST Response: " + req.responseText);
-        success(JSON.parse(req.responseText));
-      } else {
-        if (DEBUG) console.log("POST Error: " + req.status);
-        error("HTTP error: " + req.status);
+  var endpoint = diagEndpoint(url);
+  scheduleRequest(Request_Priority.Command, null, function(done) {
+    var req = new XMLHttpRequest();
+    var timeout = null;
+    var started = Date.now();
+    
+    req.onload = function(e) {
+      if (req.readyState == 4) {
+        // HTTP request completed
+        clearTimeout(timeout);
+        done();
+        
+        diagLatency("http:" + endpoint, Date.now() - started);
+        if (req.status == 200) {
+          if (DEBUG) console.log("POST Response: " + req.responseText);
+          var response = JSON.parse(req.responseText);
+          if (response.ReturnCode == "-3333") diagCount("tokenFailures");
+          success(response);
+        } else {
+          if (DEBUG) console.log("POST Error: " + req.status);
+          diagCount("httpErrors");
+          error("HTTP error: " + req.status);
+        }
       }
+    };
+    
+    // Start 10 seconds timeout for HTTP request
+    timeout = setTimeout(function() { req.abort(); done(); diagCount("timeouts"); error("Server communication timed out"); }, 10000);
+    
+    if (DEBUG) console.log("Posting data: " + JSON.stringify(data));
+    req.open("POST", url, true);
+    // Apply headers
+    for(var headerName in headers) {
+      req.setRequestHeader(headerName, headers[headerName]);
     }
-  };
-  
-  // Start 10 seconds timeout for HTTP request
-  timeout = setTimeout(function() { req.abort(); error("Server communication timed out"); }, 10000);
-  
-  if (DEBUG) console.log("Posting data: " + JSON.stringify(data));
-  req.open("POST", url, true);
-  // Apply headers
-  for(var headerName in headers) {
-    req.setRequestHeader(headerName, headers[headerName]);
-  }
-  if (haveValidToken()) req.setRequestHeader("SecurityToken", config.token);
-  // POST JSON data to server
-  req.send(JSON.stringify(data));
+    // POST JSON data to server
+    req.send(JSON.stringify(data));
+  });
 }
 
-// Send a JSON object to a URL using a HTTP PUT request. Call 'success' on success and 'error' on HTTP error
-function putData(url, data, success, error) {
-  var req = new XMLHttpRequest();
-  var timeout = null;
-  
-  req.onload = function(e) {
-    if (req.readyState == 4) {
-      // HTTP request completed
-      clearTimeout(timeout);
-      
-      if (req.status == 200) {
-        if (DEBUG) console.log("PUT Response: " + req.responseText);
-        success(JSON.parse(req.responseText));
-      } else {
-        if (DEBUG) console.log("PUT Error: " + req.status);
-        error("HTTP error: " + req.status);
+// Send a JSON object to a URL using a HTTP PUT request in an account's session with a Request_Priority
+// (and optional key, see scheduleRequest). Call 'success' on success and 'error' on HTTP error
+function putData(account, url, data, success, error, priority, key) {
+  var endpoint = diagEndpoint(url);
+  scheduleRequest(priority, key, function(done) {
+    var req = new XMLHttpRequest();
+    var timeout = null;
+    var started = Date.now();
+    
+    req.onload = function(e) {
+      if (req.readyState == 4) {
+        // HTTP request completed
+        clearTimeout(timeout);
+        done();
+        
+        diagLatency("http:" + endpoint, Date.now() - started);
+        if (req.status == 200) {
+          if (DEBUG) console.log("PUT Response: " + req.responseText);
+          var response = JSON.parse(req.responseText);
+          if (response.ReturnCode == "-3333") diagCount("tokenFailures");
+          success(response);
+        } else {
+          if (DEBUG) console.log("PUT Error: " + req.status);
+          diagCount("httpErrors");
+          error("HTTP error: " + req.status);
+        }
       }
+    };
+    
+    // Start 10 seconds timeout for HTTP request
+    timeout = setTimeout(function() { req.abort(); done(); diagCount("timeouts"); error("Server communication timed out"); }, 10000);
+    
+    if (DEBUG) console.log("Putting data: " + JSON.stringify(data));
+    req.open("PUT", url, true);
+    // Apply headers
+    for(var headerName in headers) {
+      req.setRequestHeader(headerName, headers[headerName]);
     }
-  };
-  
-  // Start 10 seconds timeout for HTTP request
-  timeout = setTimeout(function() { req.abort(); error("Server communication timed out"); }, 10000);
-  
-  if (DEBUG) console.log("Putting data: " + JSON.stringify(data));
-  req.open("PUT", url, true);
-  // Apply headers
-  for(var headerName in headers) {
-    req.setRequestHeader(headerName, headers[headerName]);
-  }
-  if (haveValidToken()) req.setRequestHeader("SecurityToken", config.token);
-  // PUT JSON data to server
-  req.send(JSON.stringify(data));
+    if (haveValidToken(account)) req.setRequestHeader("SecurityToken", account.token);
+    // PUT JSON data to server
+    req.send(JSON.stringify(data));
+  });
 }
 
-// Login to the MyQ server to get the security token
+// Login to the MyQ server to get the security token of an account
 // On success, function passed as 'success' is called with 'param' as the single parameter
 // On error, function passed as 'error' is called with a string error message
-function login(success, param, error) {
-  if (!config.username || !config.password) {
+function login(account, success, param, error) {
+  if (!account || !account.username || !account.password || !decrypt(account.password)) {
     error("Enter both a username and password in the HomeP settings on your phone.");
   } else {
     if (DEBUG) console.log("Logging in to MyQ server...");
     try {
-      if (loginCount >= 5) {
+      if (account.loginCount >= 5) {
         // Stop any possibility of getting stuck in a login loop
         error("Too many login attempts");
       } else {
-        loginCount++;
+        account.loginCount++;
+        diagCount("logins");
         
-        var credentials = {username: config.username, password: decrypt(config.password)};
+        var credentials = {username: account.username, password: decrypt(account.password)};
         
         postData(WS_URL_Login, credentials,
                function(data) {
@@ -281,8 +692,8 @@ function login(success, param, error) {
                        // Login success
                        if (DEBUG) console.log("...Login successful");
                        if (data.SecurityToken) {
-                         config.token = data.SecurityToken;
-                         config.sessionStart = new Date();
+                         account.token = data.SecurityToken;
+                         account.sessionStart = Date.now();
                          // Security token is valid for around 20 minutes, so save it to speed up app reloads within 20 minutes
                          saveConfig();
                          success(param);
@@ -327,16 +738,45 @@ function getAttrVal(device, name) {
   }
 }
 
-// Get an attribute updated time from the MyQ device object with the given name
+// Get when an attribute was updated (ms since the epoch) from the MyQ device object with the given name
 function getAttrUpdatedTime(device, name) {
   if (device && device.Attributes && Array.isArray(device.Attributes)) {
     for (var i = 0; i < device.Attributes.length; i++) {
-      if (device.Attributes[i].AttributeDisplayName == name) return new Date(parseInt(device.Attributes[i].UpdatedTime));
+      if (device.Attributes[i].AttributeDisplayName == name) return parseTime(parseInt(device.Attributes[i].UpdatedTime));
     }
     return null;
   } else {
-    return "Bad Attr";
+    return null;
+  }
+}
+
+// Get all attributes of a MyQ device object by name, so they are only searched for once per device
+function getAttrMap(device) {
+  var attrs = {};
+  if (device && device.Attributes && Array.isArray(device.Attributes)) {
+    for (var i = 0; i < device.Attributes.length; i++) {
+      attrs[device.Attributes[i].AttributeDisplayName] = device.Attributes[i];
+    }
+  }
+  return attrs;
+}
+
+// Get the descriptor of the type of a MyQ device object from the device type registry
+// (null if it is not a supported type)
+function classifyDevice(device, attrs) {
+  var typeName = device.MyQDeviceTypeName;
+  var typeId = parseInt(device.MyQDeviceTypeId);
+  for (var i = 0; i < DEVICE_TYPES.length; i++) {
+    var matchers = DEVICE_TYPES[i].matchers;
+    for (var j = 0; j < matchers.length; j++) {
+      var matcher = matchers[j];
+      if (((typeName && matcher.typeName.test(typeName) && !(matcher.notTypeName && matcher.notTypeName.test(typeName))) ||
+           matcher.typeIds.indexOf(typeId) != -1) &&
+          (!matcher.accept || matcher.accept(attrs)))
+        return DEVICE_TYPES[i];
+    }
   }
+  return null;
 }
 
 // Get the name of the MyQ device that is the parent matching the parent ID from the MyQ device list
@@ -352,44 +792,216 @@ function getParentDeviceName(devices, parentid) {
   }
 }
 
-// Get the list of devices under the MyQ account
+// Fetch the MyQ device list of an account with a Request_Priority and optional key, logging in first if
+// needed (and again if the security token is rejected). 'success' is called with the server response and
+// 'error' with a string error message
+// (With noLogin set, an account without a valid security token fails rather than logging in)
+function fetchDeviceList(account, priority, key, success, error, noLogin) {
+  if (!haveValidToken(account)) {
+    if (noLogin) {
+      error("Not logged in");
+      return;
+    }
+    // No valid security token, so login and try again
+    login(account, function() { fetchDeviceList(account, priority, key, success, error); }, null, error);
+    return;
+  }
+  getData(account, WS_URL_Device_List, null,
+         function(data) {
+           // HTTP Success
+           if (data.ReturnCode) {
+             switch (data.ReturnCode) {
+               case "0":
+                 account.sessionStart = Date.now();
+                 // On successfully completing an operation, reset the login count
+                 account.loginCount = 0;
+                 success(data);
+                 break;
+               case "-3333":
+                 // Security token failed, probably due to being too old
+                 account.failCount++;
+                 if (account.failCount >= 5)
+                   error("Security failed too many times");
+                 else if (noLogin)
+                   error("Not logged in");
+                 else
+                   // Login again and retry
+                   login(account, function() { fetchDeviceList(account, priority, key, success, error); }, null, error);
+                 break;
+               default:
+                 if (data.ErrorMessage)
+                   error(data.ErrorMessage);
+                 else
+                   error("Unknown server error: " + data.ReturnCode);
+                 break;
+             }
+           } else {
+             error("Unexpected server response while listing devices");
+           }
+         }, error, priority, key);
+}
+
+// Fetch the device lists of accounts all at once with a Request_Priority and optional key (made unique to
+// each account), calling 'done' when the last has finished with the result of each account in the same
+// order ({data: server response} or {error: string error message}). noLogin is passed to fetchDeviceList
+function fetchDeviceLists(accounts, priority, key, done, noLogin) {
+  var results = [];
+  var outstanding = accounts.length;
+  if (outstanding === 0) {
+    done(results);
+    return;
+  }
+  var fetchAccount = function(index) {
+    var finish = function(result) {
+      results[index] = result;
+      outstanding--;
+      if (outstanding === 0) done(results);
+    };
+    fetchDeviceList(accounts[index], priority, key ? key + ":" + accounts[index].username : null,
+                    function(data) { finish({data: data}); }, function(msg) { finish({error: msg}); }, noLogin);
+  };
+  for (var i = 0; i < accounts.length; i++) fetchAccount(i);
+}
+
+// Get the supported devices in a MyQ device list of the account with the given index
+function parseDeviceList(data, accountIndex) {
+  var devices = [];
+  if (data.Devices && Array.isArray(data.Devices)) {
+    for (var i = 0; i < data.Devices.length; i++) {
+      var myqDevice = data.Devices[i];
+      if (myqDevice.MyQDeviceId && (myqDevice.MyQDeviceTypeName || myqDevice.MyQDeviceTypeId)) {
+        var attrs = getAttrMap(myqDevice);
+        var deviceType = classifyDevice(myqDevice, attrs);
+        if (deviceType) {
+          var status = attrs[deviceType.statusAttr];
+          var desc = attrs.desc;
+          
+          if (DEBUG) {
+            console.log("Adding " + deviceType.label + " - DeviceID: " + myqDevice.MyQDeviceId + 
+                        ", account: " + accountIndex +
+                        ", gatewayID: " + myqDevice.ParentMyQDeviceId + 
+                        ", desc: " + (desc ? desc.Value : null) + 
+                        ", " + deviceType.statusAttr + ": " + (status ? status.Value : null) + 
+                        ", stateUpdatedTime: " + (status ? status.UpdatedTime : null));
+          }
+          
+          devices.push({DeviceID: parseInt(myqDevice.MyQDeviceId),
+                        Type: deviceType.type,
+                        Location: getParentDeviceName(data.Devices, myqDevice.ParentMyQDeviceId),
+                        Name: desc ? desc.Value : null,
+                        Status: status ? parseInt(status.Value) : NaN,
+                        StatusUpdated: Date.now(),
+                        StatusChanged: status ? parseTime(parseInt(status.UpdatedTime)) : null,
+                        Account: accountIndex});
+        }
+      }
+    }
+  }
+  return devices;
+}
+
+// Fleet of fake devices used when simulating: the number of each type of device, the length names are
+// padded out to, the locations the devices are spread over, how long doors and gates take to open or
+// close and the percent chance a device has been changed by someone else when its status is fetched
+var SIM_FLEET = {doors: 3, lights: 2, gates: 0, nameLength: 0, locations: ["Home", "Holiday Home"],
+                 travelMs: 12000, volatility: 0};
+var SIM_FILLER = " North Side Back Entrance Main Wing Upper Level East Yard";
+
+// Indicates if the MyQ servers must not be contacted: when simulating, or while a trace is replayed (so
+// replayed commands never change real devices)
+function simulating() {
+  return SIMULATE || replay !== null;
+}
+
+// Generate the devices of a simulated fleet, with the types interleaved in proportion
+function simulateFleet(fleet) {
+  var types = [{type: Device_Type.GarageDoor, count: fleet.doors, name: "Garage Door", status: Device_Status.Closed},
+               {type: Device_Type.LightSwitch, count: fleet.lights, name: "Light", status: Device_Status.Off},
+               {type: Device_Type.Gate, count: fleet.gates, name: "Gate", status: Device_Status.Closed}];
+  var added = [0, 0, 0];
+  var total = fleet.doors + fleet.lights + fleet.gates;
+  var devices = [];
+  for (var i = 0; i < total; i++) {
+    // Add the type furthest behind its share of the fleet
+    var next = -1;
+    for (var t = 0; t < types.length; t++) {
+      if (added[t] < types[t].count && (next < 0 || added[t] * types[next].count < added[next] * types[t].count)) next = t;
+    }
+    added[next]++;
+    var name = types[next].name + " " + added[next];
+    for (var f = 0; name.length < fleet.nameLength; f++) {
+      name += SIM_FILLER.charAt(f % SIM_FILLER.length);
+    }
+    devices.push({DeviceID: i + 1, Type: types[next].type, Location: fleet.locations[i % fleet.locations.length],
+                  Name: name, Status: types[next].status, StatusUpdated: Date.now(),
+                  StatusChanged: Date.now() - (i + 1) * 30 * 60000, Account: 0});
+  }
+  return devices;
+}
+
+// Start changing a simulated device (doors and gates travel to their new status)
+function simulateChange(device, status) {
+  device.StatusUpdated = Date.now();
+  device.StatusChanged = Date.now();
+  if (SIM_FLEET.travelMs > 0 && device.Type != Device_Type.LightSwitch && device.Status != status) {
+    device.Status = (status == Device_Status.OnOpen) ? Device_Status.Opening : Device_Status.Closing;
+    device.SimTarget = status;
+    device.SimArrives = Date.now() + SIM_FLEET.travelMs;
+  } else {
+    device.Status = status;
+    device.SimTarget = null;
+  }
+}
+
+// Bring a simulated device's status up to date: travel ends once it is due, and otherwise the device may
+// have been changed by someone else
+function simulateStatus(device) {
+  var status = null;
+  if (device.SimTarget !== null && device.SimTarget !== undefined) {
+    if (Date.now() >= device.SimArrives) status = device.SimTarget;
+  } else if (Math.random() * 100 < SIM_FLEET.volatility) {
+    if (device.Status == Device_Status.OnOpen)
+      status = (device.Type == Device_Type.LightSwitch) ? Device_Status.Off : Device_Status.Closed;
+    else
+      status = Device_Status.OnOpen;
+  }
+  if (status !== null) {
+    device.Status = status;
+    device.StatusChanged = Date.now();
+    device.SimTarget = null;
+  }
+}
+
+// Get the list of devices under all the MyQ accounts
+// Send the IDs of the saved devices to the watch as a C-style array (the watch then requests the details
+// of each device)
+function sendDeviceList() {
+  var deviceids = [];
+  for (var i = 0; i < config.devices.length; i++) {
+    appendInt32(deviceids, config.devices[i].DeviceID);
+  }
+  Pebble.sendAppMessage({"function_key": Function_Key.DeviceList, "device_list": deviceids});
+}
+
 function getDeviceList() {
   try {
     if (config.devices && Array.isArray(config.devices) && config.devices.length > 0) {
       if (DEBUG) console.log("Getting SAVED device list");
-      var deviceids = [];
-      // If device list has been saved, just build C-style array of device IDs for passing to the Pebble
-      for (var i = 0; i < config.devices.length; i++) {
-        appendInt32(deviceids, config.devices[i].DeviceID);
-      }
-      // Send device IDs to Pebble (which will then request individual device details)
-      Pebble.sendAppMessage({"function_key": Function_Key.DeviceList, "device_list": deviceids});
+      // If device list has been saved, just send that, then check it is still current
+      sendDeviceList();
+      if (!simulating()) revalidateDeviceList();
     } else {
       if (DEBUG) console.log("Getting LATEST device list");
       
       // If simulating, build fake list of devices and return that
-      if (SIMULATE) {
-        config.devices = [];
-        var updated = new Date((new Date()).getTime() - (30 * 60000));
-        config.devices.push({DeviceID: 1, Type: Device_Type.GarageDoor, Location: "Home", Name: "Garage Door 1",
-                             Status: Device_Status.Closed, StatusUpdated: new Date(), StatusChanged: updated});
-        config.devices.push({DeviceID: 2, Type: Device_Type.GarageDoor, Location: "Home", Name: "Garage Door 2",
-                             Status: Device_Status.Closed, StatusUpdated: new Date(), StatusChanged: updated});
-        config.devices.push({DeviceID: 3, Type: Device_Type.LightSwitch, Location: "Home", Name: "Hall",
-                             Status: Device_Status.Off, StatusUpdated: new Date(), StatusChanged: updated});
-        config.devices.push({DeviceID: 4, Type: Device_Type.LightSwitch, Location: "Home", Name: "Side Door",
-                             Status: Device_Status.Off, StatusUpdated: new Date(), StatusChanged: updated});
-        config.devices.push({DeviceID: 5, Type: Device_Type.GarageDoor, Location: "Holiday Home", Name: "Garage Door",
-                             Status: Device_Status.Closed, StatusUpdated: new Date(), StatusChanged: updated});
-
+      if (simulating()) {
+        config.devices = simulateFleet(SIM_FLEET);
         var ids = [];
 
         // Build C-style array of device IDs for passing to the Pebble
-        appendInt32(ids, 1);
-        appendInt32(ids, 2);
-        appendInt32(ids, 3);
-        appendInt32(ids, 4);
-        appendInt32(ids, 5);
+        for (var d = 0; d < config.devices.length; d++) {
+          appendInt32(ids, config.devices[d].DeviceID);
+        }
 
         // Send FAKE device IDs to Pebble during simulation (which will then request individual device details)
         Pebble.sendAppMessage({"function_key": Function_Key.DeviceList, "device_list": ids});
@@ -397,119 +1009,167 @@ function getDeviceList() {
         return;
       }
       
-      // Else fetch the latest device list from the MyQ server
-      if (haveValidToken()) {
-        getData(WS_URL_Device_List, null,
-               function(data) {
-                 // HTTP Success
-                 if (data.ReturnCode) {
-                   switch (data.ReturnCode) {
-                     case "0":
-                       // Parse MyQ device list
-                       raw_devices = JSON.stringify(data);
-                       var deviceids = [];
-                       config.sessionStart = new Date();
-                       config.devices = [];
-                       if (data.Devices && Array.isArray(data.Devices)) {
-                         for (var i = 0; i < data.Devices.length; i++) {
-                           if (data.Devices[i].MyQDeviceId && (data.Devices[i].MyQDeviceTypeName || data.Devices[i].MyQDeviceTypeId)) {
-                             // MyQ Garage Door openers have "garage door" in the TypeName or TypeID of 47.
-                             // "MyQ Garage" devices for 3rd party devices have VGDO in the TypeName or TypeID of 259 and a 
-                             //  'oemtransmitter' attribute value that is not 255 (filters out the duplicate)
-                             if ((data.Devices[i].MyQDeviceTypeName && data.Devices[i].MyQDeviceTypeName.search(/garage\s*door/i) != -1) || 
-                                 (data.Devices[i].MyQDeviceTypeId && data.Devices[i].MyQDeviceTypeId == 47) ||
-                                 (((data.Devices[i].MyQDeviceTypeName && data.Devices[i].MyQDeviceTypeName.search(/gdo/i) != -1 && 
-                                    data.Devices[i].MyQDeviceTypeName.search(/gateway/i) == -1) || 
-                                    (data.Devices[i].MyQDeviceTypeId && data.Devices[i].MyQDeviceTypeId == 259)) &&
-                                       getAttrVal(data.Devices[i], "oemtransmitter") != 255 &&
-                                       getAttrVal(data.Devices[i], "desc"))) {
-                               
-                               if (DEBUG) {
-                                 console.log("Adding Garage Door - DeviceID: " + data.Devices[i].MyQDeviceId + 
-                                             ", gatewayID: " + data.Devices[i].ParentMyQDeviceId + 
-                                             ", desc: " + getAttrVal(data.Devices[i], "desc") + 
-                                             ", doortstate: " + getAttrVal(data.Devices[i], "doorstate") + 
-                                             ", stateUpdatedTime: " + getAttrUpdatedTime(data.Devices[i], "doorstate"));
-                               }
-                               
-                               // Add Garage Door Openers devices to JS array
-                               config.devices.push({DeviceID: parseInt(data.Devices[i].MyQDeviceId),
-                                                    Type: Device_Type.GarageDoor,
-                                                    Location: getParentDeviceName(data.Devices, data.Devices[i].ParentMyQDeviceId),
-                                                    Name: getAttrVal(data.Devices[i], "desc"),
-                                                    Status: parseInt(getAttrVal(data.Devices[i], "doorstate")),
-                                                    StatusUpdated: new Date(),
-                                                    StatusChanged: getAttrUpdatedTime(data.Devices[i], "doorstate")});
-    
-                               // Build C-style array of device IDs for passing to the Pebble
-                               appendInt32(deviceids, parseInt(data.Devices[i].MyQDeviceId));
-                               
-                             } else if ((data.Devices[i].MyQDeviceTypeName && data.Devices[i].MyQDeviceTypeName.search(/light|lamp/i) != -1) || 
-                                 (data.Devices[i].MyQDeviceTypeId && data.Devices[i].MyQDeviceTypeId == 48)) {
-                               
-                               if (DEBUG) {
-                                 console.log("Adding Light Switch - DeviceID: " + data.Devices[i].MyQDeviceId + 
-                                             ", gatewayID: " + data.Devices[i].ParentMyQDeviceId + 
-                                             ", desc: " + getAttrVal(data.Devices[i], "desc") + 
-                                             ", lightstate: " + getAttrVal(data.Devices[i], "lightstate") + 
-                                             ", stateUpdatedTime: " + getAttrUpdatedTime(data.Devices[i], "lightstate"));
-                               }
-                               
-                               // Add Light Switch devices to JS array
-                               config.devices.push({DeviceID: parseInt(data.Devices[i].MyQDeviceId),
-                                                    Type: Device_Type.LightSwitch,
-                                                    Location: getParentDeviceName(data.Devices, data.Devices[i].ParentMyQDeviceId),
-                                                    Name: getAttrVal(data.Devices[i], "desc"),
-                                                    Status: parseInt(getAttrVal(data.Devices[i], "lightstate")),
-                                                    StatusUpdated: new Date(),
-                                                    StatusChanged: getAttrUpdatedTime(data.Devices[i], "lightstate")});
-    
-                               // Build C-style array of device IDs for passing to the Pebble
-                               appendInt32(deviceids, parseInt(data.Devices[i].MyQDeviceId));
-                               
-                             }
-                           }
-                         }
-                       } 
-                       // Save device list
-                       saveConfig();
-                       // Send device IDs to Pebble (which will then request individual device details)
-                       Pebble.sendAppMessage({"function_key": Function_Key.DeviceList, "device_list": deviceids});
-                       
-                       // On successfully completing an operation, reset the login count
-                       loginCount = 0;
-                       break;
-                     case "-3333":
-                       // Security token failed, probably due to being too old
-                       failCount++;
-                       if (failCount >= 5)
-                         sendError("Security failed too many times");
-                       else {
-                         // Login again and retry this function
-                         login(getDeviceList, null, function(msg) { sendError(msg); });
-                       }
-                       break;
-                     default:
-                       if (data.ErrorMessage)
-                         sendError(data.ErrorMessage);
-                       else
-                         sendError("Unknown server error: " + data.ReturnCode);
-                       break;
-                   }
-                 } else {
-                   sendError("Unexpected server response while listing devices");
-                 }
-               }, function(msg) { sendError(msg); });
-      } else {
-        // No valid security token, so login and try again
-        login(getDeviceList, null, function(msg) { sendError(msg); });
-      }
+      // Else fetch the latest device lists of all accounts from the MyQ servers at once and merge them
+      // (a device shared by more than one account is only listed once, under the first account)
+      var previous = config.devices || [];
+      fetchDeviceLists(config.accounts, Request_Priority.Status, "list", function(results) {
+        var devices = [];
+        var deviceids = [];
+        var listed = {};
+        var raw = [];
+        var errorMsg = null;
+        var failedAccount = null;
+        var addDevice = function(device) {
+          if (listed[device.DeviceID]) return;
+          listed[device.DeviceID] = true;
+          devices.push(device);
+          // Build C-style array of device IDs for passing to the Pebble
+          appendInt32(deviceids, device.DeviceID);
+        };
+        for (var a = 0; a < results.length; a++) {
+          if (results[a].error) {
+            // Keep any saved devices of an account that could not be listed
+            if (errorMsg === null) {
+              errorMsg = results[a].error;
+              failedAccount = config.accounts[a];
+            }
+            for (var p = 0; p < previous.length; p++) {
+              if (previous[p].Account == a) addDevice(previous[p]);
+            }
+          } else {
+            raw.push(JSON.stringify(results[a].data));
+            var accountDevices = parseDeviceList(results[a].data, a);
+            for (var i = 0; i < accountDevices.length; i++) addDevice(accountDevices[i]);
+          }
+        }
+        if (errorMsg !== null && devices.length === 0) {
+          sendError(errorMsg);
+          return;
+        }
+        if (raw.length > 0) raw_devices = raw.join("\n");
+        
+        // Save device list (unless an account is missing from it)
+        config.devices = devices;
+        config.devicesIncomplete = (errorMsg !== null);
+        saveConfig();
+        // Send device IDs to Pebble (which will then request individual device details), then the error
+        // of an account that could not be listed
+        Pebble.sendAppMessage({"function_key": Function_Key.DeviceList, "device_list": deviceids});
+        if (errorMsg !== null) sendError(failedAccount.username + ": " + errorMsg);
+      });
     }
   } catch (err) {
     sendError("Error getting devices: " + err.message);
   }
 }
 
+// How long after a device's status was set that the watch may still be checking for it to change
+// (the same as the watch app's status change timeout)
+var STATUS_CHANGE_MS = 60000;
+
+// Check the saved device list against the latest device lists in the background, updating it and sending
+// only the differences to the watch: the IDs of added and removed devices, then the details of devices
+// that have been renamed (or moved). Only accounts with a valid security token are checked, and this never
+// logs in (an account whose token is rejected is left unchecked). Added devices go to the end of the list,
+// as they do on the watch. If the watch does not acknowledge the changes, the whole list is sent instead
+function revalidateDeviceList() {
+  var accounts = [];
+  var accountIndexes = [];
+  for (var a = 0; a < config.accounts.length; a++) {
+    if (haveValidToken(config.accounts[a])) {
+      accounts.push(config.accounts[a]);
+      accountIndexes.push(a);
+    }
+  }
+  if (accounts.length === 0) return;
+  
+  fetchDeviceLists(accounts, Request_Priority.Prefetch, "revalidate", function(results) {
+    if (!config.devices || !Array.isArray(config.devices)) return;
+    var fetched = {};
+    var latest = [];
+    var latestByID = {};
+    var raw = [];
+    for (var r = 0; r < results.length; r++) {
+      if (!results[r].data) continue;
+      fetched[accountIndexes[r]] = true;
+      raw.push(JSON.stringify(results[r].data));
+      var accountDevices = parseDeviceList(results[r].data, accountIndexes[r]);
+      for (var i = 0; i < accountDevices.length; i++) {
+        if (latestByID[accountDevices[i].DeviceID]) continue;
+        latestByID[accountDevices[i].DeviceID] = accountDevices[i];
+        latest.push(accountDevices[i]);
+      }
+    }
+    if (raw.length === 0) return;
+    if (raw.length == config.accounts.length) raw_devices = raw.join("\n");
+    
+    var devices = [];
+    var kept = {};
+    var removedIDs = [];
+    var renamed = [];
+    for (var j = 0; j < config.devices.length; j++) {
+      var device = config.devices[j];
+      var current = latestByID[device.DeviceID];
+      if (current) {
+        // Update the saved device rather than replace it, since a running scene may refer to it
+        if (current.Name != device.Name || current.Location != device.Location || current.Type != device.Type)
+          renamed.push(device);
+        device.Name = current.Name;
+        device.Location = current.Location;
+        device.Type = current.Type;
+        device.Status = current.Status;
+        device.StatusUpdated = current.StatusUpdated;
+        device.StatusChanged = current.StatusChanged;
+        device.Account = current.Account;
+        kept[device.DeviceID] = true;
+        devices.push(device);
+      } else if (fetched[device.Account]) {
+        appendInt32(removedIDs, device.DeviceID);
+      } else {
+        // Not checked, since its account's session has expired
+        devices.push(device);
+      }
+    }
+    var addedIDs = [];
+    for (var k = 0; k < latest.length; k++) {
+      if (kept[latest[k].DeviceID]) continue;
+      devices.push(latest[k]);
+      appendInt32(addedIDs, latest[k].DeviceID);
+    }
+    config.devices = devices;
+    saveConfig();
+    
+    var messages = [];
+    if (addedIDs.length > 0 || removedIDs.length > 0) {
+      var changes = {"function_key": Function_Key.DeviceChanges};
+      if (addedIDs.length > 0) changes.device_list = addedIDs;
+      if (removedIDs.length > 0) changes.device_removed = removedIDs;
+      messages.push(changes);
+    }
+    for (var n = 0; n < renamed.length; n++) {
+      messages.push({"function_key": Function_Key.DeviceDetails,
+                     "device_id": renamed[n].DeviceID,
+                     "device_location": renamed[n].Location,
+                     "device_name": renamed[n].Name,
+                     "device_type": renamed[n].Type});
+    }
+    if (DEBUG) console.log("Device list revalidated - added: " + (addedIDs.length / 4) + ", removed: " +
+                           (removedIDs.length / 4) + ", renamed: " + renamed.length);
+    
+    // Send the changes one after the other (waiting for each to be acknowledged), falling back to sending the
+    // whole list so the watch does not keep the old list
+    var sendChange = function(index) {
+      if (index >= messages.length) return;
+      Pebble.sendAppMessage(messages[index], function() { sendChange(index + 1); },
+                            function() {
+                              if (DEBUG) console.log("Failed sending device list changes to watch");
+                              sendDeviceList();
+                            });
+    };
+    sendChange(0);
+  }, true);
+}
+
 // Get status of a specified device by ID
 function getDeviceStatus(deviceID) {
   if (DEBUG) console.log("getDeviceStatus(" + deviceID + ")");
@@ -517,37 +1177,42 @@ function getDeviceStatus(deviceID) {
     var device = findDevice(deviceID);
     
     if (device) {
-      if (((new Date()) - device.StatusUpdated) < 2000 || SIMULATE) {
+      if ((Date.now() - device.StatusUpdated) < 2000 || simulating()) {
         // If the device status is less that 2 seconds old or SIMULATING, return the saved status
+        diagCount("cacheHits");
+        if (simulating()) simulateStatus(device);
         if (DEBUG) {
-          if (SIMULATE)
+          if (simulating())
             console.log("Simulating. Returning fake status");
           else
             console.log("Status LESS than 2 seconds old. Returning save status");
         } 
         Pebble.sendAppMessage({"function_key": Function_Key.GetStatus, 
                                "device_id": deviceID,
-                               "device_status": device.Status,
-                               "status_changed": timeToDesc(device.StatusChanged)});
+                               "device_status": getKnownStatus(device),
+                               "status_changed": timeToEpoch(device.StatusChanged)});
       } else {
-        // Fetch latest device status
+        // Fetch latest device status (in the session of the account the device is under)
+        diagCount("cacheMisses");
         if (DEBUG) console.log("Status MORE than 2 seconds old. Fetching latest status");
-        if (haveValidToken()) {
-          var attrName = null;
+        var account = getDeviceAccount(device);
+        if (account && haveValidToken(account)) {
           // Determine attribute used for this device's status
-          if (device.Type == Device_Type.GarageDoor) {
-            attrName = "doorstate";
-          } else if (device.Type == Device_Type.LightSwitch) {
-            attrName = "lightstate";
-          }
+          var attrName = getStatusAttrName(device);
           
           if (attrName) {
             var params = {
               myQDeviceId: deviceID,
               attributeName: attrName
             };
+            // The watch checks on a device it has just changed until it reaches its new status, otherwise
+            // it is fetching the status of the device it is showing, which replaces any earlier request
+            // for a device that is no longer shown
+            var changing = getDeviceCommand(device) !== null;
+            var priority = changing ? Request_Priority.Poll : Request_Priority.Status;
+            var key = changing ? "poll:" + deviceID : "status";
             
-            getData(WS_URL_Device_GetAttr, params,
+            getData(account, WS_URL_Device_GetAttr, params,
                    function(data) {
                      // HTTP Success
                      if (data.ReturnCode) {
@@ -555,38 +1220,38 @@ function getDeviceStatus(deviceID) {
                          case "0":
                            // Success
                            if (DEBUG) console.log("Status successfully fetched");
-                           config.sessionStart = new Date();
-                           device.StatusUpdated = new Date();
+                           account.sessionStart = Date.now();
+                           device.StatusUpdated = Date.now();
                            if (data.AttributeValue) {
                              // Send MyQ device status to watch app
                              device.Status = parseInt(data.AttributeValue);
-                             device.StatusChanged = new Date(parseInt(data.UpdatedTime));
+                             device.StatusChanged = parseTime(parseInt(data.UpdatedTime));
                              Pebble.sendAppMessage({"function_key": Function_Key.GetStatus, 
                                                     "device_id": deviceID,
-                                                    "device_status": device.Status,
-                                                    "status_changed": timeToDesc(device.StatusChanged)});
+                                                    "device_status": getKnownStatus(device),
+                                                    "status_changed": timeToEpoch(device.StatusChanged)});
                            } else {
                              device.Status = -2; // Missing status attribute
                              Pebble.sendAppMessage({"function_key": Function_Key.GetStatus, 
                                                     "device_id": deviceID,
-                                                    "device_status": device.Status,
-                                                    "status_changed": ""});
+                                                    "device_status": getKnownStatus(device),
+                                                    "status_changed": 0});
                            }
                            // Save latest status and when it was last updated
                            saveConfig();
                            
                            // On successfully completing an operation, reset the login count
-                           loginCount = 0;
+                           account.loginCount = 0;
                            break;
                          case "-3333":
-                           if (DEBUG) console.log("Security token failure - Fail count: " + failCount);
+                           if (DEBUG) console.log("Security token failure - Fail count: " + account.failCount);
                            // Security token failed, probably due to being too old
-                           failCount++;
-                           if (failCount >= 5)
+                           account.failCount++;
+                           if (account.failCount >= 5)
                              sendError("Security failed too many times");
                            else {
                              // Login again and retry this function
-                             login(getDeviceStatus, deviceID, function(msg) { sendError(msg); });
+                             login(account, getDeviceStatus, deviceID, function(msg) { sendError(msg); });
                            }
                            break;
                          default:
@@ -600,12 +1265,12 @@ function getDeviceStatus(deviceID) {
                      } else {
                        sendError("Unexpected server response while getting device status");
                      }
-                   }, function(msg) { sendError(msg); });
+                   }, function(msg) { sendError(msg); }, priority, key);
           }
         } else {
           if (DEBUG) console.log("No valid security token, logging in and with then get device status");
           // No valid security token, so login and try again
-          login(getDeviceStatus, deviceID, function(msg) { sendError(msg); });
+          login(account, getDeviceStatus, deviceID, function(msg) { sendError(msg); });
         }
       }
     }
@@ -614,88 +1279,254 @@ function getDeviceStatus(deviceID) {
   }
 }
 
-// Set the status of a device
-// DeviceID and Status passed as params object so that it can be called as login success function
+// Get the attribute holding the status of a device
+function getStatusAttrName(device) {
+  var deviceType = deviceTypes[device.Type];
+  return deviceType ? deviceType.statusAttr : null;
+}
+
+// Get the status of a device to send to the watch (Loading if it is not known, rather than a value the
+// watch would take as Off)
+function getKnownStatus(device) {
+  return (typeof device.Status == "number" && isFinite(device.Status)) ? device.Status : Device_Status.Loading;
+}
+
+// Maximum bytes of device summaries sent in one message (must fit in the smallest watch inbox,
+// INBOX_SIZE_MIN in comms.c, with room to spare)
+var SUMMARY_CHUNK_SIZE = 1000;
+
+// Send the details and status of every saved device to the watch in as few messages as possible
+// Each device is a record of: Device ID (int32), Type (uint8), Status (int8), Status Changed (uint32 
+// seconds since the epoch), Location and Name (null terminated strings)
+function sendDeviceSummary() {
+  var chunks = [];
+  var chunk = [];
+  for (var i = 0; i < config.devices.length; i++) {
+    var device = config.devices[i];
+    var record = [];
+    appendInt32(record, device.DeviceID);
+    record.push(device.Type & 0xff);
+    record.push(getKnownStatus(device) & 0xff);
+    appendInt32(record, timeToEpoch(device.StatusChanged));
+    appendString(record, device.Location);
+    appendString(record, device.Name);
+    if (chunk.length > 0 && chunk.length + record.length > SUMMARY_CHUNK_SIZE) {
+      chunks.push(chunk);
+      chunk = [];
+    }
+    chunk = chunk.concat(record);
+  }
+  if (chunk.length > 0) chunks.push(chunk);
+  
+  // Send chunks one after the other (waiting for each to be acknowledged)
+  var sendChunk = function(index) {
+    if (index >= chunks.length) return;
+    Pebble.sendAppMessage({"function_key": Function_Key.DeviceSummary, "device_summary": chunks[index]},
+                          function() { sendChunk(index + 1); },
+                          function() { sendError("Failed sending device summary to watch"); });
+  };
+  sendChunk(0);
+}
+
+// Update the saved status of every known device from a MyQ device list
+function updateDeviceStatuses(devices) {
+  if (devices && Array.isArray(devices)) {
+    for (var i = 0; i < devices.length; i++) {
+      var device = findDevice(devices[i].MyQDeviceId);
+      var attrName = device ? getStatusAttrName(device) : null;
+      if (attrName && getAttrVal(devices[i], attrName) !== null) {
+        device.Status = parseInt(getAttrVal(devices[i], attrName));
+        device.StatusChanged = getAttrUpdatedTime(devices[i], attrName);
+        device.StatusUpdated = Date.now();
+      }
+    }
+  }
+}
+
+// Get the accounts devices are under (each account only once, in account order)
+function getDevicesAccounts(devices) {
+  var accounts = [];
+  for (var a = 0; a < config.accounts.length; a++) {
+    for (var i = 0; i < devices.length; i++) {
+      if (devices[i].Account == a) {
+        accounts.push(config.accounts[a]);
+        break;
+      }
+    }
+  }
+  return accounts;
+}
+
+// Get the latest status of all devices with a single request per account and send a summary of them to the watch
+function getDeviceSummary() {
+  if (DEBUG) console.log("getDeviceSummary()");
+  try {
+    if (!config.devices || !Array.isArray(config.devices)) return;
+    
+    // If simulating, just send the saved statuses
+    if (simulating()) {
+      config.devices.forEach(simulateStatus);
+      sendDeviceSummary();
+      return;
+    }
+    
+    // Fetch the device lists of all accounts with devices at once, then send the summary after the last
+    // (devices of an account whose list could not be fetched keep their saved status)
+    fetchDeviceLists(getDevicesAccounts(config.devices), Request_Priority.Prefetch, "summary", function(results) {
+      var errorMsg = null;
+      var fetched = 0;
+      for (var i = 0; i < results.length; i++) {
+        if (results[i].error) {
+          if (errorMsg === null) errorMsg = results[i].error;
+        } else {
+          updateDeviceStatuses(results[i].data.Devices);
+          fetched++;
+        }
+      }
+      if (fetched === 0 && errorMsg !== null) {
+        sendError(errorMsg);
+        return;
+      }
+      saveConfig();
+      sendDeviceSummary();
+    });
+  } catch (err) {
+    sendError("Error getting device summary: " + err.message);
+  }
+}
+
+// Get the object for setting a device attribute to change a device to the given status
+// (null if the status of this type of device can not be set)
+function getDesiredAttr(device, status) {
+  var deviceType = deviceTypes[device.Type];
+  if (!deviceType || !deviceType.desiredAttr) return null;
+  return {
+    myQDeviceId: device.DeviceID.toString(),
+    attributeName: deviceType.desiredAttr,
+    AttributeValue: (status == Device_Status.OnOpen) ? 1 : 0
+  };
+}
+
+// Status change commands from the watch by device ID, each with its command ID, the status it changes the
+// device to, when it was started and when the server accepted it (null until then)
+var deviceCommands = {};
+
+// Get the command changing a device, if there is one still changing it (it has been accepted by the server
+// in the last STATUS_CHANGE_MS or is still being sent, and the device has not reached its new status)
+function getDeviceCommand(device) {
+  var command = deviceCommands[device.DeviceID];
+  if (!command) return null;
+  var status = (device.Status == Device_Status.VGDOOpen) ? Device_Status.OnOpen : device.Status;
+  if ((Date.now() - (command.sent || command.started)) >= STATUS_CHANGE_MS || (command.sent && status == command.status)) {
+    delete deviceCommands[device.DeviceID];
+    return null;
+  }
+  return command;
+}
+
+// Let the watch app know a status change command was accepted by the server, so it can start checking for
+// the status change
+function sendStatusSet(device, commandID) {
+  Pebble.sendAppMessage({"function_key": Function_Key.SetStatus,
+                         "device_id": device.DeviceID,
+                         "command_id": commandID || 0});
+}
+
+// Set the status of a device for a command from the watch (DeviceID, Status and CommandID)
+// A repeat of a command is ignored (or confirmed again if it has been sent), and a command to change a
+// device to the status a command is already changing it to is collapsed into that command rather than
+// sent to the server again. Any other command supersedes the device's command, and the PUT of a
+// superseded command is dropped if it has not started
 function setDeviceStatus(params) {
   try {
     var device = findDevice(params.DeviceID);
+    if (!device) return;
     
-    if (device) {
+    var command = getDeviceCommand(device);
+    if (command && (command.id == params.CommandID || command.status == params.Status)) {
+      if (DEBUG) console.log("Command " + params.CommandID + " collapsed into command " + command.id);
+      command.id = params.CommandID;
+      if (command.sent) sendStatusSet(device, command.id);
+      return;
+    }
+    
+    command = {id: params.CommandID, status: params.Status, started: Date.now(), sent: null};
+    deviceCommands[device.DeviceID] = command;
+    putDeviceStatus({DeviceID: device.DeviceID, Status: params.Status, Command: command});
+  } catch (err) {
+    sendError("Error setting status: " + err.message);
+  }
+}
+
+// Send a status change command to the server
+// DeviceID, Status and the Command are passed as params object so that it can be called as login success function
+function putDeviceStatus(params) {
+  try {
+    var device = findDevice(params.DeviceID);
+    var command = params.Command;
+    
+    // Stop if the command has been superseded
+    if (device && deviceCommands[device.DeviceID] === command) {
       // If simulating, just update the device status without contacting a server
-      if (SIMULATE) {
-        device.Status = params.Status;
-        device.StatusUpdated = new Date();
-        device.StatusChanged = new Date();
+      if (simulating()) {
+        simulateChange(device, params.Status);
+        command.sent = Date.now();
         
         // Success. Let watch app know so it can update the status
-        Pebble.sendAppMessage({"function_key": Function_Key.SetStatus, 
-                                                "device_id": device.DeviceID});
+        sendStatusSet(device, command.id);
         
         return;
       }
       
-      // Else send the new status to the real MyQ server
-      if (haveValidToken()) {
-        var attrName = null;
-        var desiredStatus = null;
-        // Determine attribute and status value used for this device type
-        if (device.Type == Device_Type.GarageDoor) {
-          attrName = "desireddoorstate";
-          desiredStatus = (params.Status == Device_Status.OnOpen) ? 1 : 0;
-        } else if (device.Type == Device_Type.LightSwitch) {
-          attrName = "desiredlightstate";
-          desiredStatus = (params.Status == Device_Status.OnOpen) ? 1 : 0;
-        } 
-        if (attrName) {
-          // Setup object for setting device attribute
-          var deviceParams = {
-            myQDeviceId: params.DeviceID.toString(),
-            attributeName: attrName,
-            AttributeValue: desiredStatus,
-          };
-          
-          // Send attribute data to server
-          putData(WS_URL_Device_SetAttr, deviceParams, 
+      // Else send the new status to the real MyQ server (in the session of the account the device is under)
+      var account = getDeviceAccount(device);
+      if (account && haveValidToken(account)) {
+        var deviceParams = getDesiredAttr(device, params.Status);
+        if (deviceParams) {
+          // Send attribute data to server (replacing the queued PUT of a command it supersedes)
+          putData(account, WS_URL_Device_SetAttr, deviceParams, 
                  function(data) {
                    // HTTP Success
                    if (data.ReturnCode) {
                      switch (data.ReturnCode) {
                        case "0":
-                         // Success. Let watch app know so it can start checking for status change
-                         Pebble.sendAppMessage({"function_key": Function_Key.SetStatus, 
-                                                "device_id": device.DeviceID});
+                         // Success. Let watch app know so it can start checking for status change (unless the
+                         // command was superseded while it was being sent)
+                         command.sent = Date.now();
+                         if (deviceCommands[device.DeviceID] === command) sendStatusSet(device, command.id);
                          
-                         config.sessionStart = new Date();
+                         account.sessionStart = Date.now();
                          saveConfig();
                          break;
                        case "-3333":
                          // Security token failed, probably due to being too old
-                         failCount++;
-                         if (failCount >= 5)
-                           sendError("Security failed too many times");
+                         account.failCount++;
+                         if (account.failCount >= 5)
+                           commandFailed(device, command, "Security failed too many times");
                          else {
                            // Login again and retry this function after a brief pause
-                           login(setDeviceStatus, params, function(msg) { sendError(msg); });
+                           login(account, putDeviceStatus, params, function(msg) { commandFailed(device, command, msg); });
                          }
                          
                          // On successfully completing an operation, reset the login count
-                         loginCount = 0;
+                         account.loginCount = 0;
                          break;
                        default:
                          if (data.ErrorMessage)
-                           sendError(data.ErrorMessage);
+                           commandFailed(device, command, data.ErrorMessage);
                          else
-                           sendError("Unknown server error: " + data.ReturnCode);
+                           commandFailed(device, command, "Unknown server error: " + data.ReturnCode);
                          break;
                      }
                    } else {
-                     sendError("Unexpected server response while setting device status");
+                     commandFailed(device, command, "Unexpected server response while setting device status");
                    }
-                 }, function(msg) { sendError(msg); });
+                 }, function(msg) { commandFailed(device, command, msg); },
+                 Request_Priority.Command, "command:" + device.DeviceID);
         }
       } else {
         // No valid security token, so login and try again
-        login(setDeviceStatus, params, function(msg) { sendError(msg); });
+        login(account, putDeviceStatus, params, function(msg) { commandFailed(device, command, msg); });
       }
     }
   } catch (err) {
@@ -703,9 +1534,287 @@ function setDeviceStatus(params) {
   }
 }
 
+// Forget a command that failed (so it can be tried again) and show the error, unless it was superseded
+function commandFailed(device, command, msg) {
+  if (deviceCommands[device.DeviceID] !== command) return;
+  delete deviceCommands[device.DeviceID];
+  sendError(msg);
+}
+
+// How long the devices of a running scene have to reach their new status
+// (how often they are polled comes from the poll profile of each device type)
+var SCENE_TIMEOUT_MS = 60000;
+
+// The scene currently running (only one scene runs at a time)
+var activeScene = null;
+
+// Get the status a scene changes a device to (null if the scene does not change this type of device)
+function getSceneStatus(device, sceneID) {
+  var deviceType = deviceTypes[device.Type];
+  if (!deviceType) return null;
+  for (var i = 0; i < deviceType.scenes.length; i++) {
+    if (deviceType.scenes[i].id == sceneID) return deviceType.scenes[i].status;
+  }
+  return null;
+}
+
+// Get the devices a scene changes, each with the status it is changed to
+// (devices already in that status are left alone)
+function getSceneTargets(sceneID) {
+  var targets = [];
+  if (!config.devices || !Array.isArray(config.devices)) return targets;
+  for (var i = 0; i < config.devices.length; i++) {
+    var device = config.devices[i];
+    var status = getSceneStatus(device, sceneID);
+    if (status !== null && device.Status != status && getDesiredAttr(device, status))
+      targets.push({device: device, status: status, state: "pending"});
+  }
+  return targets;
+}
+
+// Send the progress of a scene to the watch as the number of devices finished (changed or failed)
+// out of the total
+function sendSceneProgress(scene) {
+  var done = 0;
+  var failed = 0;
+  for (var i = 0; i < scene.targets.length; i++) {
+    if (scene.targets[i].state == "done") done++;
+    if (scene.targets[i].state == "failed") failed++;
+  }
+  Pebble.sendAppMessage({"function_key": Function_Key.Scene,
+                         "scene_id": scene.id,
+                         "scene_done": done + failed,
+                         "scene_total": scene.targets.length,
+                         "scene_failed": failed});
+}
+
+// Tell the watch a scene could not be run (it fails without any devices)
+function sendSceneFailed(sceneID) {
+  Pebble.sendAppMessage({"function_key": Function_Key.Scene,
+                         "scene_id": sceneID,
+                         "scene_done": 0,
+                         "scene_total": 0,
+                         "scene_failed": 1});
+}
+
+// Finish a scene, failing devices that have not reached their new status, and send the final progress
+// followed by a summary of all devices so the watch shows their latest status
+function finishScene(scene, error) {
+  if (scene.pollTimer) clearTimeout(scene.pollTimer);
+  for (var i = 0; i < scene.targets.length; i++) {
+    if (scene.targets[i].state != "done") scene.targets[i].state = "failed";
+  }
+  if (activeScene == scene) activeScene = null;
+  saveConfig();
+  sendSceneProgress(scene);
+  if (error) sendError(error);
+  sendDeviceSummary();
+}
+
+// Run a scene. The new status of every device is sent to the server at once, then all of them are
+// tracked together, so a scene takes as long as its slowest device
+function runScene(sceneID) {
+  if (DEBUG) console.log("runScene(" + sceneID + ")");
+  try {
+    // Report progress of a scene that is already running rather than starting another (and that the
+    // requested scene could not start, if it is a different one)
+    if (activeScene) {
+      if (activeScene.id != sceneID) sendSceneFailed(sceneID);
+      sendSceneProgress(activeScene);
+      return;
+    }
+    
+    var scene = {id: sceneID, targets: getSceneTargets(sceneID), started: Date.now(), pollTimer: null, polls: 0,
+                 error: null};
+    if (scene.targets.length === 0) {
+      // Nothing to change
+      sendSceneProgress(scene);
+      return;
+    }
+    
+    // If simulating, just update the device statuses without contacting a server
+    if (simulating()) {
+      for (var i = 0; i < scene.targets.length; i++) {
+        var device = scene.targets[i].device;
+        device.Status = scene.targets[i].status;
+        device.StatusUpdated = Date.now();
+        device.StatusChanged = Date.now();
+        scene.targets[i].state = "done";
+      }
+      finishScene(scene);
+      return;
+    }
+    
+    activeScene = scene;
+    sendSceneProgress(scene);
+    putSceneTargets(scene);
+  } catch (err) {
+    activeScene = null;
+    sendSceneFailed(sceneID);
+    sendError("Error running scene: " + err.message);
+  }
+}
+
+// Send the new status of every pending device in a scene to the server in parallel (in the session of
+// the account each device is under), then start polling once all the requests have completed
+function putSceneTargets(scene) {
+  var accountTargets = [];
+  for (var i = 0; i < scene.targets.length; i++) {
+    var target = scene.targets[i];
+    if (target.state != "pending") continue;
+    if (!accountTargets[target.device.Account]) accountTargets[target.device.Account] = [];
+    accountTargets[target.device.Account].push(target);
+  }
+  var outstanding = 0;
+  var failed = false;
+  var accountDone = function(accountFailed) {
+    if (accountFailed) failed = true;
+    outstanding--;
+    if (outstanding === 0) continueScene(scene, failed);
+  };
+  for (var a = 0; a < accountTargets.length; a++) {
+    if (accountTargets[a]) outstanding++;
+  }
+  for (var j = 0; j < accountTargets.length; j++) {
+    if (accountTargets[j]) putAccountTargets(scene, config.accounts[j], accountTargets[j], accountDone);
+  }
+}
+
+// Send the new status of scene devices under one account to the server in parallel, logging in first if
+// needed (and again for devices rejected due to the security token). 'done' is called once all the
+// requests have completed, indicating if any device failed
+function putAccountTargets(scene, account, targets, done) {
+  var failTargets = function(msg) {
+    for (var i = 0; i < targets.length; i++) {
+      if (targets[i].state == "pending") targets[i].state = "failed";
+    }
+    if (msg && !scene.error) scene.error = msg;
+    done(true);
+  };
+  if (!account) {
+    failTargets(null);
+    return;
+  }
+  if (!haveValidToken(account)) {
+    // No valid security token, so login and try again
+    login(account, function() { putAccountTargets(scene, account, targets, done); }, null, failTargets);
+    return;
+  }
+  
+  var pending = [];
+  for (var i = 0; i < targets.length; i++) {
+    if (targets[i].state == "pending") pending.push(targets[i]);
+  }
+  var outstanding = pending.length;
+  var tokenFailed = false;
+  var failed = false;
+  
+  var putDone = function() {
+    outstanding--;
+    if (outstanding > 0) return;
+    if (tokenFailed) {
+      // Security token failed, probably due to being too old
+      account.failCount++;
+      if (account.failCount >= 5)
+        failTargets("Security failed too many times");
+      else
+        // Login again and retry the devices that were rejected
+        login(account, function() { putAccountTargets(scene, account, targets, done); }, null, failTargets);
+    } else {
+      done(failed);
+    }
+  };
+  
+  var putTarget = function(target) {
+    putData(account, WS_URL_Device_SetAttr, getDesiredAttr(target.device, target.status),
+           function(data) {
+             // HTTP Success
+             switch (data.ReturnCode) {
+               case "0":
+                 target.state = "sent";
+                 account.sessionStart = Date.now();
+                 // On successfully completing an operation, reset the login count
+                 account.loginCount = 0;
+                 break;
+               case "-3333":
+                 tokenFailed = true;
+                 break;
+               default:
+                 if (DEBUG) console.log("Scene set status error: " + data.ErrorMessage + " (" + data.ReturnCode + ")");
+                 target.state = "failed";
+                 failed = true;
+                 break;
+             }
+             putDone();
+           }, function(msg) {
+             target.state = "failed";
+             failed = true;
+             putDone();
+           }, Request_Priority.Command, null);
+  };
+  for (var j = 0; j < pending.length; j++) putTarget(pending[j]);
+}
+
+// Get how long to wait before polling a scene, from the poll profiles of its devices that are still
+// changing (the quickest device decides, so the first poll waits until the quickest could have changed)
+function getScenePollDelay(scene) {
+  var delay = null;
+  for (var i = 0; i < scene.targets.length; i++) {
+    var deviceType = deviceTypes[scene.targets[i].device.Type];
+    if (scene.targets[i].state != "sent" || !deviceType) continue;
+    var typeDelay = (scene.polls === 0) ? deviceType.poll.firstCheck : deviceType.poll.interval;
+    if (delay === null || typeDelay < delay) delay = typeDelay;
+  }
+  return (delay === null) ? 0 : delay;
+}
+
+// Poll the status of all devices with a single request per account until every device in a scene
+// reaches its new status (or the scene times out), updating the watch as devices finish
+function pollScene(scene) {
+  scene.pollTimer = setTimeout(function() {
+    scene.pollTimer = null;
+    scene.polls++;
+    // Only the accounts of devices that are still changing are polled
+    var changing = [];
+    for (var i = 0; i < scene.targets.length; i++) {
+      if (scene.targets[i].state == "sent") changing.push(scene.targets[i].device);
+    }
+    fetchDeviceLists(getDevicesAccounts(changing), Request_Priority.Poll, null, function(results) {
+      var changed = false;
+      for (var a = 0; a < results.length; a++) {
+        if (results[a].data) updateDeviceStatuses(results[a].data.Devices);
+      }
+      for (var i = 0; i < scene.targets.length; i++) {
+        var target = scene.targets[i];
+        if (target.state == "sent" && target.device.Status == target.status) {
+          target.state = "done";
+          changed = true;
+        }
+      }
+      continueScene(scene, changed);
+    });
+  }, getScenePollDelay(scene));
+}
+
+// Keep polling a scene until none of its devices are still changing or it has timed out
+// (progress is sent if devices have finished, unless the final progress is about to be sent)
+function continueScene(scene, changed) {
+  var changing = false;
+  for (var i = 0; i < scene.targets.length; i++) {
+    if (scene.targets[i].state == "sent") changing = true;
+  }
+  if (!changing || (Date.now() - scene.started) > SCENE_TIMEOUT_MS) {
+    finishScene(scene, scene.error);
+  } else {
+    if (changed) sendSceneProgress(scene);
+    pollScene(scene);
+  }
+}
+
 // Initialize app
+// (The password is only decrypted if a login is needed, so a saved session starts without any crypto)
 function init() {
-  if (!SIMULATE && (!config.username || !config.password || !decrypt(config.password))) {
+  if (!SIMULATE && !haveCredentials()) {
     Pebble.sendAppMessage({"function_key": Function_Key.Error,
                            "error_message": "Enter both a username and password in the HomeP settings on your phone."});
   } else {
@@ -714,11 +1823,114 @@ function init() {
   }
 }
 
+// App Message trace recording and replay. With MSG_RECORD set every message to and from the watch is
+// logged as 'MSG <ms> <'>' watch to phone or '<' phone to watch> <payload as JSON>' (the same lines
+// the watch app logs with its MSG_RECORD define) and the latest are kept in localStorage.msgTrace.
+// With MSG_RECORD set a trace can also be replayed into the JS by calling replayTrace (e.g. from the
+// debugger), which simulates the MyQ servers meanwhile. host/replay replays traces into the watch app.
+var MSG_TRACE_MAX = 500;
+var REPLAY_SETTLE_MS = 5000;
+var msgTrace = [];
+var msgTraceStart = null;
+var appMessageListener = null;
+var replay = null;
+
+// Add a message to the trace
+function recordMessage(direction, payload) {
+  var now = Date.now();
+  if (msgTraceStart === null) msgTraceStart = now;
+  var line = "MSG " + (now - msgTraceStart) + " " + direction + " " + JSON.stringify(payload);
+  console.log(line);
+  msgTrace.push(line);
+  if (msgTrace.length > MSG_TRACE_MAX) msgTrace.shift();
+  localStorage.msgTrace = msgTrace.join("\n");
+}
+
+if (MSG_RECORD) {
+  // Intercept messages to and from the watch (messages from the watch are ignored during a replay,
+  // and messages to it, which can then only be replies to the replayed messages, are captured and
+  // acknowledged instead of sent)
+  var pebbleSendAppMessage = Pebble.sendAppMessage;
+  var pebbleAddEventListener = Pebble.addEventListener;
+  
+  Pebble.sendAppMessage = function(payload, success, failure) {
+    if (replay) {
+      var line = JSON.stringify(payload);
+      if (replay.expected[line]) {
+        replay.expected[line]--;
+        replay.matched++;
+      }
+      replay.sent++;
+      if (success) setTimeout(function() { success({data: payload}); }, 0);
+      return;
+    }
+    recordMessage("<", payload);
+    return pebbleSendAppMessage.call(Pebble, payload, success, failure);
+  };
+  
+  Pebble.addEventListener = function(type, listener) {
+    if (type != "appmessage") return pebbleAddEventListener.call(Pebble, type, listener);
+    appMessageListener = listener;
+    pebbleAddEventListener.call(Pebble, type, function(e) {
+      if (replay) return;
+      recordMessage(">", e.payload);
+      listener(e);
+    });
+  };
+}
+
+// Replay the watch messages in a trace (JSON payloads only, as logged by the JS) at their original
+// times or, with maxSpeed, one after the other. done is called once the JS has settled with the
+// number of messages delivered, sent and sent as in the trace (or with null if the replay could not
+// start: without MSG_RECORD, or while requests or a scene are in progress, whose messages would be
+// mistaken for the replay's). The saved config is reloaded afterwards, dropping the simulated changes
+function replayTrace(trace, maxSpeed, done) {
+  var messages = [];
+  var expected = {};
+  var lines = trace.split("\n");
+  for (var i = 0; i < lines.length; i++) {
+    var match = /MSG (\d+) ([<>]) (\{.*\})\s*$/.exec(lines[i]);
+    if (!match) continue;
+    if (match[2] == ">") {
+      messages.push({time: parseInt(match[1], 10), payload: JSON.parse(match[3])});
+    } else {
+      var line = JSON.stringify(JSON.parse(match[3]));
+      expected[line] = (expected[line] || 0) + 1;
+    }
+  }
+  if (!appMessageListener || replay || activeRequests > 0 || requestQueue.length > 0 || activeScene) {
+    if (done) done(null);
+    return;
+  }
+  
+  replay = {expected: expected, sent: 0, matched: 0};
+  var started = Date.now();
+  var deliver = function(index) {
+    if (index >= messages.length) {
+      setTimeout(function() {
+        var result = {delivered: messages.length, sent: replay.sent, matched: replay.matched,
+                      elapsed: Date.now() - started};
+        replay = null;
+        loadConfig();
+        if (DEBUG) console.log("Replay finished: " + JSON.stringify(result));
+        if (done) done(result);
+      }, REPLAY_SETTLE_MS);
+      return;
+    }
+    appMessageListener({payload: messages[index].payload});
+    var delay = (maxSpeed || index + 1 >= messages.length) ? 0 : messages[index + 1].time - messages[index].time;
+    setTimeout(function() { deliver(index + 1); }, delay);
+  };
+  var first = (maxSpeed || messages.length === 0) ? 0 : messages[0].time;
+  setTimeout(function() { deliver(0); }, first);
+}
+
 Pebble.addEventListener("ready",
                         function(e) {
                           if (DEBUG) console.log("JS Ready");
                           // Application startup,
                           loadConfig();
+                          loadDiagnostics();
                           init();
                         });
 
@@ -766,12 +1978,27 @@ Pebble.addEventListener("appmessage",
                                 }
                                 break;
                                 
+                              case Function_Key.DeviceSummary:
+                                // Watch app requesting details and status of all devices
+                                if (DEBUG) console.log("Sending device summary");
+                                getDeviceSummary();
+                                break;
+                                
+                              case Function_Key.Scene:
+                                // Watch app running a scene
+                                if (e.payload.scene_id) {
+                                  if (DEBUG) console.log("Running scene: " + e.payload.scene_id);
+                                  runScene(e.payload.scene_id);
+                                }
+                                break;
+                                
                               case Function_Key.SetStatus:
                                 // Watch app setting device status
                                 if (e.payload.device_id && e.payload.device_status !== null) {
                                   if (DEBUG) console.log("Setting status for ID " + e.payload.device_id + " to: " + e.payload.device_status);
                                   
-                                  setDeviceStatus({DeviceID: e.payload.device_id, Status: e.payload.device_status});
+                                  setDeviceStatus({DeviceID: e.payload.device_id, Status: e.payload.device_status,
+                                                   CommandID: e.payload.command_id});
                                 }
                                 break;
                             }
@@ -782,45 +2009,67 @@ Pebble.addEventListener("showConfiguration",
                          function() {
                            if (DEBUG) console.log("Showing Settings...");
                            
+                           // Username and password of each account, with a blank account at the end for adding another
+                           var accountFields = '';
+                           for (var a = 0; a <= config.accounts.length; a++) {
+                             var account = config.accounts[a] || newAccount("", "");
+                             accountFields += '<fieldset>\
+			<label for="username' + a + '">' + ((a < config.accounts.length) ? 'Username:' : 'Add another account - Username:') + '</label><br>\
+			<input type="email" id="username' + a + '" style="width: 90%; font-size: larger;" value="' + account.username + '" ><br>\
+			<label for="password' + a + '">Password:</label><br>\
+			<input type="password" id="password' + a + '" style="width: 90%; font-size: larger;" autocomplete="off" value="' + decrypt(account.password) + '" >\
+		</fieldset>';
+                           }
+                           
                            // Settings page HTML, which will be used in a Data URI
                            var html = '<html>\
 	<head>\
 		<meta charset="utf-8" /><meta name="viewport" content="width=device-width, initial-scale=1" />\
 		<script type="text/javascript" language="Javascript">\
 			function login(refreshDevices) {\
-				var username = document.getElementById("username");\
-				var password = document.getElementById("password");\
-				if (username.value.trim() == "") {\
-					alert("A username must be entered.");\
-					username.focus();\
-					return false;\
+				var accounts = [];\
+				for (var i = 0; document.getElementById("username" + i); i++) {\
+					var username = document.getElementById("username" + i);\
+					var password = document.getElementById("password" + i);\
+					if (username.value.trim() == "") continue;\
+					if (password.value.trim() == "") {\
+						alert("A password must be entered.");\
+						password.focus();\
+						return false;\
+					}\
+					accounts.push({"username":username.value,"password":password.value});\
 				}\
-				if (password.value.trim() == "") {\
-					alert("A password must be entered.");\
-					password.focus();\
+				if (accounts.length == 0) {\
+					alert("A username must be entered.");\
+					document.getElementById("username0").focus();\
 					return false;\
 				}\
-				document.location = "pebblejs://close#" + encodeURIComponent(JSON.stringify({"username":username.value,"password":password.value,"refreshDevices":refreshDevices}));\
+				document.location = "pebblejs://close#" + encodeURIComponent(JSON.stringify({"accounts":accounts,"refreshDevices":refreshDevices}));\
 				return true;\
 			}\
+			function resetDiagnostics() {\
+				document.location = "pebblejs://close#" + encodeURIComponent(JSON.stringify({"resetDiagnostics":true}));\
+			}\
 		</script>\
 	</head>\
 <body style="font-family: sans-serif;">\
 		<p>Setup your account and devices as per the MyQ&#8482; device manufacturer&apos;s instructions first.</p>\
     <p>Enter your MyQ&#8482; username and password below and tap "Login". These will be saved on your phone and only ever sent to the official MyQ&#8482; servers. If you lose your phone, change your password as soon as possible. If you lose your Pebble, delete the Bluetooth connection on your phone.</p>\
+		<p>To control devices from more than one MyQ&#8482; account (e.g. a holiday home with its own account), enter each account. Clear the username of an account to remove it.</p>\
 		<p>If you add devices to your account at a later date, tap "Refresh Devices" below.</p>\
 		<p>NOTE: Most garage door openers will beep for a period before starting to close when operated remotely. This is functionality built into the garage door opener and is done for safety under UL standards. Always operate garage doors with caution.</p>\
-		<fieldset>\
-			<label for="username">Username:</label><br>\
-			<input type="email" id="username" style="width: 90%; font-size: larger;" value="' + config.username + '" ><br>\
-			<label for="password">Password:</label><br>\
-			<input type="password" id="password" style="width: 90%; font-size: larger;" autocomplete="off" value="' + decrypt(config.password) + '" >\
-		</fieldset>\
+' + accountFields + '\
 		<fieldset>\
 			<input type="button" value="Login" style="font-size: larger;" onclick="login(false);" />\
 			<input type="button" value="Refresh Devices" style="font-size: larger;" onclick="login(true);" />\
 			<div style="float: right; font-size: xx-small;">' + version + '</div>\
 		</fieldset><br>\
+		<fieldset>\
+			<label>Diagnostics:</label>\
+			<p>If HomeP is slow, these show where the time goes: MyQ&#8482; server requests (http), waiting for other requests (queue), logging in, or sending to your Pebble (send).</p>\
+			' + diagnosticsHtml() + '\
+			<input type="button" value="Reset Diagnostics" style="font-size: larger;" onclick="resetDiagnostics();" />\
+		</fieldset><br>\
 		<fieldset>\
 			<label>Raw Device Data:</label>\
 			<p>If "No devices found" or "Unknown device" is displayed on your watch and you have used the correct username and password above and tapped <b>Refresh Devices</b>, then the raw device data will need to be examined to determine the cause.</p>';
@@ -866,12 +2115,22 @@ Pebble.addEventListener("webviewclosed",
                              } catch(ex) {
                                settings = JSON.parse(decodeURIComponent(e.response));
                              }
-                             // Username and Password should always be returned
-                             config.username = settings.username;
-                             config.password = encrypt(settings.password);
-                             // Reset login session
-                             config.token = null;
-                             config.sessionStart = null;
+                             if (settings.resetDiagnostics) {
+                               // 'Reset Diagnostics' tapped
+                               diagnostics = defaultDiagnostics();
+                               localStorage.diagnostics = JSON.stringify(diagnostics);
+                               return;
+                             }
+                             // At least one account should always be returned (settings from before multiple
+                             // accounts have a single username and password)
+                             var accounts = settings.accounts || [{username: settings.username, password: settings.password}];
+                             wipeCredentialCache();
+                             // New accounts have no login session
+                             config.accounts = [];
+                             for (var i = 0; i < accounts.length; i++) {
+                               if (accounts[i].username)
+                                 config.accounts.push(newAccount(accounts[i].username, encrypt(accounts[i].password)));
+                             }
                              // Always force refresh of device list after tapping 'Login' or 'Refresh Devices'
                              config.devices = null;
                              